@@ -0,0 +1,57 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <memory_resource>
+#include <utils.h>
+
+/*
+    Bump allocator holding every node of one program. Nodes are still handed out as shared pointers, but each one is placed, together
+    with its reference counts, in the arena's buffers, which are freed all at once when the last node built in it goes away.
+    Nothing is freed per node
+*/
+class Arena {
+
+    public:
+        /// @brief `initial_size` sizes the first buffer, a good guess is what the last program used
+        Arena(size_t initial_size = 64 * 1024) :
+            resource(std::max(initial_size, (size_t)1024))
+        {}
+
+        inline void* allocate(size_t bytes, size_t alignment){
+            bytes_used += bytes;
+            return resource.allocate(bytes, alignment);
+        }
+
+        inline size_t get_bytes_used() const {return bytes_used;}
+
+    private:
+        std::pmr::monotonic_buffer_resource resource;
+        size_t bytes_used = 0;
+};
+
+/*
+    every allocation keeps the arena alive, so nodes that outlive their program (i.e in a genome's DAG) stay valid
+*/
+template<typename T>
+struct Arena_allocator {
+
+    using value_type = T;
+
+    Arena_allocator(std::shared_ptr<Arena> _arena) : arena(std::move(_arena)) {}
+
+    template<typename U>
+    Arena_allocator(const Arena_allocator<U>& other) : arena(other.arena) {}
+
+    inline T* allocate(size_t n){
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    inline void deallocate(T*, size_t) noexcept {}
+
+    template<typename U>
+    bool operator==(const Arena_allocator<U>& other) const {return arena == other.arena;}
+
+    std::shared_ptr<Arena> arena;
+};
+
+#endif
@@ -3,13 +3,33 @@
 
 #include <optional>
 #include <algorithm>
-#include <term.h>
-#include <grammar.h>
+#include <climits>
+#include <atomic>
+#include <ir.h>
 #include <node.h>
 #include <context.h>
 #include <dag.h>
+#include <emitter.h>
+#include <program.h>
 
-struct Genome;
+enum Derivation_status : U8 {
+    DS_DONE,
+    DS_SUSPENDED,
+    DS_OVER_BUDGET,
+    DS_CANCELLED,
+};
+
+/*
+    where a derivation started and how far it got, as a plain value that can be copied, kept and resumed later. The tree, blocks 
+    and DAG of a derivation follow from these given the grammar, entry, weights and limits, so they are made again on resuming 
+    rather than copied. Resuming is a replay, which takes as long as deriving that far did: the frames of a derivation hold nodes
+    of a half built tree that the context's blocks, resources and DAG also point into, so there is no state that copies on its own
+*/
+struct Derivation_state {
+    std::mt19937 rng;
+    std::optional<Node_constraint> swarm_testing_gateset;
+    unsigned int n_nodes = 0;
+};
 
 class Ast{
     public:
@@ -17,32 +37,170 @@ class Ast{
 
         ~Ast() = default;
 
-        inline void set_entry(const std::shared_ptr<Rule> _entry){
+        inline void set_entry(const std::shared_ptr<const Ir::Grammar> _grammar, Ir::Index _entry){
+            if(grammar != _grammar) reset_weights();
+
+            grammar = _grammar;
             entry = _entry;
         }
 
-        inline bool entry_set(){return entry != nullptr;}
+        inline bool entry_set(){return entry.has_value();}
+
+        inline std::optional<Ir::Index> get_entry() const {return entry;}
+
+        /// @brief Override the weight of the branch at `offset` within the rule, for builds by this AST only
+        void set_weight(Ir::Index rule, Ir::Index offset, float weight);
+
+        /// @brief Go back to the weights written in the grammar
+        void reset_weights();
+
+        inline float branch_weight(Ir::Index branch) const {
+            auto it = weight_overrides.find(branch);
+            return (it == weight_overrides.end()) ? grammar->branch(branch).weight : it->second;
+        }
 
-        void write_branch(std::shared_ptr<Node> parent, const Term& term);
+        /// @brief Pick a branch of the rule that satisfies the parent's constraint, filling `repetitions` with the counts to expand it with.
+        /// Nothing if the rule is empty
+        std::optional<Ir::Index> pick_branch(Ir::Index rule, const std::shared_ptr<Node> parent, std::vector<unsigned int>& repetitions);
 
-        std::shared_ptr<Node> get_node(const std::shared_ptr<Node> parent, const Term& term);
+        std::shared_ptr<Node> get_node(const std::shared_ptr<Node> parent, const Ir::Term& term);
 
         inline void set_ast_counter(const int& counter){context.set_ast_counter(counter);}
 
-        Result<Node> build(const std::optional<Genome>& genome, std::optional<Node_constraint>& swarm_testing_gateset);
+        inline std::mt19937& rng(){return context.rng();}
+
+        inline void seed(U64 seed){context.seed(seed);}
+
+        /// @brief Build a program from the entry, writing what was built (blocks and DAG) to `report`. With a `sink`, the program's text
+        /// goes to it as it is derived, the root of the program that comes back has no children, and its DAG only has the main circuit's stats.
+        /// The DAG of a `genome` is moved into the program built from it
+        Result<Program> build(std::optional<Genome>&& genome, std::optional<Node_constraint>& swarm_testing_gateset, std::ostream& report = std::cout,
+            Emitter* sink = nullptr);
+
+        /*
+            `build` in steps, for callers that want to suspend a derivation and resume it later, as `build` does to keep to the
+            `build_time_limit`. Everything the derivation needs to carry on is kept in this builder between calls to `derive`, so
+            nothing else may build with it in the meantime
+        */
+
+        /// @brief Set up a build from the entry without deriving anything. False if the entry isn't set
+        bool start(std::optional<Genome>&& genome, std::optional<Node_constraint>& swarm_testing_gateset, std::ostream& report = std::cout,
+            Emitter* sink = nullptr);
+
+        /// @brief Carry on with the derivation for at most `max_nodes` more nodes, or until it is cancelled. Throws if no branch can be picked
+        Derivation_status derive(unsigned int max_nodes = UINT_MAX);
+
+        /// @brief Make `derive` stop at the next node, and every call after it until the next build starts. Can be called from any thread
+        inline void cancel(){cancelled.store(true, std::memory_order_relaxed);}
+
+        /// @brief The state of the derivation so far. Nothing for builds from a genome, whose DAG is used up by the build
+        std::optional<Derivation_state> save() const;
+
+        /// @brief Start the build `state` was saved from again, and derive as far as it had got, so that `derive` carries on from there. 
+        /// This builder needs the same grammar, entry, weights and limits as the one that saved it. With a `sink`, the program is printed 
+        /// from the start. False if the entry isn't set, or if the replay doesn't get exactly as far, i.e it was cancelled, ran over 
+        /// this builder's node limit, or finished early
+        bool resume(const Derivation_state& state, std::ostream& report = std::cout, Emitter* sink = nullptr);
 
-        Genome genome();
+        /// @brief Make the DAG of a finished derivation, report what was built, and hand over the tree and the DAG to the program
+        Result<Program> finish();
 
-        inline void render_dag(const fs::path& current_circuit_dir){dag.render_dag(current_circuit_dir);}
+        /// @brief Limits every program built from here on is held to
+        inline void set_limits(const Common::Limits& limits){context.set_limits(limits);}
+
+        inline const Common::Limits& get_limits() const {return context.get_limits();}
+
+        /// @brief Build the main circuit of programs to this size, or not to any size. Programs built from a genome follow its DAG instead
+        inline void set_size_target(const std::optional<Common::Size_target>& size_target){context.set_size_target(size_target);}
+
+        /// @brief New builder over the same grammar, entry and weights, with build state of its own, so it can build alongside this one
+        std::shared_ptr<Ast> fork() const;
 
     protected:
 
-        std::shared_ptr<Rule> entry = nullptr;
-        std::shared_ptr<Node> dummy = std::make_shared<Node>("");
+        struct Candidates {
+            std::vector<Ir::Index> branches;
+            Alias_table alias;
+        };
+
+        inline const Alias_table& rule_alias_table(Ir::Index rule) const {
+            auto it = alias_overrides.find(rule);
+            return (it == alias_overrides.end()) ? grammar->rule_alias_table(rule) : it->second;
+        }
+
+        /// @brief Index into `branches` picked by weight, uniformly if all weights are 0
+        size_t pick_weighted(const std::vector<Ir::Index>& branches);
+
+        /*
+            a node being derived. Its remaining terms are `terms[next_term, end_term)`, and those from `first_term` belong to it
+        */
+        struct Frame {
+            std::shared_ptr<Node> node;
+            size_t first_term;
+            size_t next_term;
+            size_t end_term;
+            bool picked_branch;
+            bool prints_children;
+            bool keeps_children;
+        };
+
+        /// @brief Pick the node's branch and queue up its terms. `prints_children` is whether a streamed node's children are printed
+        void push_frame(const std::shared_ptr<Node>& node, const Ir::Term& term, bool prints_children);
+
+        /// @brief Attach, or print, the child made for the next term of the frame on top, and push it unless it is already complete
+        void derive_child(const Ir::Term& term);
+
+        std::shared_ptr<const Ir::Grammar> grammar = nullptr;
+        std::optional<Ir::Index> entry = std::nullopt;
+
+        /*
+            branches of a rule that may satisfy a constraint, keyed by rule and constraint. Kept here rather than in the grammar so the 
+            grammar stays read-only
+        */
+        std::map<std::pair<Ir::Index, std::vector<unsigned int>>, Candidates> constraint_index;
+
+        /*
+            weights set from the REPL, by branch, and the alias tables of the rules they change. The grammar's own tables are shared and never change
+        */
+        std::unordered_map<Ir::Index, float> weight_overrides;
+        std::unordered_map<Ir::Index, Alias_table> alias_overrides;
+
+        /*
+            derivation state. The work stack replaces recursion, so the depth of a program is only bounded by the budget, and 
+            the derivation can stop between any two nodes
+        */
+        std::vector<Frame> stack;
+        std::vector<const Ir::Term*> terms;
+        std::vector<unsigned int> repetitions;
+        std::shared_ptr<Node> root = nullptr;
+        bool from_genome = false;
+
+        unsigned int depth = 0;
+        unsigned int n_nodes = 0;
+
+        /*
+            the RNG as it was when the build started, which with `n_nodes` is all `save` needs
+        */
+        std::mt19937 start_rng;
+        std::atomic<bool> cancelled = false;
+
+        /*
+            stands in for indentation, which prints nothing. Shared by every builder on a thread, so it is never derived
+        */
+        static thread_local const std::shared_ptr<Node> dummy;
         
         Context::Context context;
         std::optional<Node_constraint> swarm_testing_gateset = std::nullopt;
+        std::ostream* report = &std::cout;
         Dag::Dag dag;
+
+        /*
+            streaming state. `n_muted` counts the nodes being derived whose children are never printed, and `n_keeping` those
+            that keep their children
+        */
+        Emitter* sink = nullptr;
+        unsigned int n_muted = 0;
+        unsigned int n_keeping = 0;
 };
 
 #endif
@@ -10,9 +10,10 @@
 #include <compound_stmts.h>
 #include <gate.h>
 #include <subroutine_defs.h>
-#include <genome.h>
+#include <dag.h>
 #include <nested_stmt.h>
 #include <nested_branch.h>
+#include <arena.h>
 
 namespace Context {
 
@@ -29,6 +30,66 @@ namespace Context {
 
 			void reset(Level l);
 
+			/// @brief New node in the arena of the program being built, with the next id in the program. Streamed programs let go of
+			/// most nodes as soon as they are printed, so those are allocated one at a time instead
+			template<typename T, typename... Args>
+			inline std::shared_ptr<T> make(Args&&... args){
+				std::shared_ptr<T> node;
+
+				if(streamed_dag != nullptr){
+					node = std::make_shared<T>(std::forward<Args>(args)...);
+				} else {
+					node = std::allocate_shared<T>(Arena_allocator<T>(arena), std::forward<Args>(args)...);
+				}
+
+				node->set_id(node_counter++);
+
+				return node;
+			}
+
+			/// @brief Put `child` last under `parent` in the tree of the program being built
+			inline void add_child(Node& parent, std::shared_ptr<Node> child){
+				nodes->add_child(parent, std::move(child));
+			}
+
+			/// @brief Table of the tree of the program being built
+			inline std::shared_ptr<const Node_table> get_nodes() const {return nodes;}
+
+			/// @brief `resource`, or a node of its own in the program if it's a block sentinel. Sentinels are shared and never change,
+			/// while the nodes put in the program get children derived under them
+			template<typename T>
+			inline std::shared_ptr<T> unshared(const std::shared_ptr<T>& resource){
+				return Block::is_sentinel(resource) ? make<T>() : resource;
+			}
+
+			/// @brief Stream the program being built, or not if `dag` is null. Qubits of a streamed program keep no flow path, the qubit ops
+			/// of its main circuit go straight into `dag` instead, which only keeps what it needs for its stats
+			inline void set_streaming(Dag::Dag* dag){streamed_dag = dag;}
+
+			inline void set_limits(const Common::Limits& _limits){limits = _limits;}
+
+			inline const Common::Limits& get_limits() const {return limits;}
+
+			/// @brief Size the main circuit of programs built without a genome is built to, if any
+			inline void set_size_target(const std::optional<Common::Size_target>& _size_target){size_target = _size_target;}
+
+			/// @brief Generator every random choice in this build is drawn from
+			inline std::mt19937& rng(){return random_gen;}
+
+			/// @brief Restart the generator, a program built straight after is the same for the same seed
+			inline void seed(U64 seed){
+				std::seed_seq seq{(uint32_t)seed, (uint32_t)(seed >> 32)};
+				random_gen.seed(seq);
+			}
+
+			inline void indent(){
+				if(indent_depth < UINT8_MAX) indent_depth++;
+			}
+
+			inline void dedent(){
+				if(indent_depth) indent_depth--;
+			}
+
 			inline std::string get_current_block_owner(){
 				return current_block_owner;
 			}
@@ -67,7 +128,7 @@ namespace Context {
 
 			inline std::shared_ptr<Subroutine_op_arg> new_arg(){
 				if((current_gate != nullptr) && *current_gate == Token::SUBROUTINE){
-					current_subroutine_op_arg = std::make_shared<Subroutine_op_arg>(current_gate->get_next_qubit_def());
+					current_subroutine_op_arg = make<Subroutine_op_arg>(current_gate->get_next_qubit_def());
 				}
 
 				return current_subroutine_op_arg;
@@ -78,7 +139,7 @@ namespace Context {
 			}
 
 			inline std::shared_ptr<Qubit_definition> new_qubit_definition(const U8& scope){
-				current_qubit_definition = get_current_block()->get_next_qubit_def(scope);
+				current_qubit_definition = unshared(get_current_block()->get_next_qubit_def(scope));
 				return current_qubit_definition;
 			}
 
@@ -87,7 +148,7 @@ namespace Context {
 			std::shared_ptr<Integer> get_current_qubit_definition_size();
 
 			inline std::shared_ptr<Bit_definition> new_bit_definition(const U8& scope){
-				current_bit_definition = get_current_block()->get_next_bit_def(scope);
+				current_bit_definition = unshared(get_current_block()->get_next_bit_def(scope));
 				return current_bit_definition;
 			}
 			
@@ -96,7 +157,7 @@ namespace Context {
 			std::shared_ptr<Integer> get_current_bit_definition_size();
 
 			inline std::shared_ptr<Gate> new_gate(const std::string& str, Token::Kind& kind, int num_qubits, int num_bits, int num_params){
-				current_gate = std::make_shared<Gate>(str, kind, num_qubits, num_bits, num_params);
+				current_gate = make<Gate>(str, kind, num_qubits, num_bits, num_params);
 
 				if(current_qubit_op != nullptr) current_qubit_op->set_gate_node(current_gate);
 
@@ -104,7 +165,7 @@ namespace Context {
 			}
 
 			inline std::shared_ptr<Gate> new_gate(const std::string& str, Token::Kind& kind, const Collection<Qubit_definition>& qubit_defs){
-				current_gate = std::make_shared<Gate>(str, kind, qubit_defs);
+				current_gate = make<Gate>(str, kind, qubit_defs);
 
 				if(current_qubit_op != nullptr) current_qubit_op->set_gate_node(current_gate);
 
@@ -126,7 +187,7 @@ namespace Context {
 			std::shared_ptr<Qubit_op> new_qubit_op_node(){
 				reset(QUBIT_OP);
 
-				current_qubit_op = can_copy_dag ? genome.value().dag.get_next_node() : std::make_shared<Qubit_op>(get_current_block());
+				current_qubit_op = can_copy_dag ? genome_dag->get_next_node() : make<Qubit_op>(get_current_block());
 
 				return current_qubit_op;
 			}
@@ -139,21 +200,46 @@ namespace Context {
 
 			inline void set_ast_counter(const int& counter){ast_counter = counter;}
 
-			inline std::shared_ptr<Integer> get_circuit_id(){return std::make_shared<Integer>(ast_counter);}
+			inline std::shared_ptr<Integer> get_circuit_id(){return make<Integer>(ast_counter);}
 
-			void set_genome(const std::optional<Genome>& _genome);
+			/// @brief DAG of the genome the program is built from, which the builder owns for the length of the build. Null if there isn't one
+			inline void set_genome_dag(Dag::Dag* dag){genome_dag = dag;}
 
-			inline void print_block_info() const {		
+			inline void print_block_info(std::ostream& stream) const {		
 				for(const std::shared_ptr<Block>& block : blocks){
-					block->print_info();
+					block->print_info(stream);
 				}
 			}
 
         private:
+			bool on_spine(size_t n_qubits);
+
+			std::shared_ptr<Arena> arena = std::make_shared<Arena>();
+			std::shared_ptr<Node_table> nodes = std::make_shared<Node_table>();
+
+			/*
+				everything a build changes as it goes lives here, so builders running at the same time share nothing
+			*/
+			std::mt19937 random_gen{std::random_device{}()};
+			int node_counter = 0;
+			U8 indent_depth = 0;
+			Dag::Dag* streamed_dag = nullptr;
+			Common::Limits limits;
+
 			std::string current_block_owner;
             std::vector<std::shared_ptr<Block>> blocks;
+
+			/*
+				blocks that came before the current one, and the fewest external qubits of a subroutine among them
+			*/
+			size_t n_settled_blocks = 0;
+			size_t min_subroutine_external_qubits = SIZE_MAX;
 			
-			std::shared_ptr<Block> dummy_block = std::make_shared<Block>();
+			/*
+				the current block before any block is made. Shared by every context on a thread, so it is never changed
+			*/
+			static thread_local const std::shared_ptr<Block> dummy_block;
+
 			Integer dummy_int;
 			Variable dummy_var;
 
@@ -171,9 +257,20 @@ namespace Context {
 			std::shared_ptr<Subroutine_op_arg> current_subroutine_op_arg;
 
 			std::optional<std::shared_ptr<Subroutine_defs>> subroutines_node = std::nullopt;
-			std::optional<Genome> genome;
+			Dag::Dag* genome_dag = nullptr;
 
 			bool can_copy_dag;
+
+			/*
+				whether the block being built shares out a number of qubit ops between its statements, which it does when it is 
+				copied from a DAG or built to a size target. The qubit ops of a size targeted block that go on `spine_qubit` make up 
+				the path that sets its depth. `n_spine_ops` counts them, and `n_placed_ops` counts every qubit op of the block so far
+			*/
+			std::optional<Common::Size_target> size_target = std::nullopt;
+			bool partitioning = false;
+			unsigned int n_spine_ops = 0;
+			unsigned int n_placed_ops = 0;
+			std::optional<size_t> spine_qubit = std::nullopt;
     };
 
 }
@@ -0,0 +1,85 @@
+#ifndef EMITTER_H
+#define EMITTER_H
+
+#include <node.h>
+
+/*
+    Writes a program out as text. The tree is walked with an explicit stack rather than by recursion, everything is appended to one
+    buffer, and the buffer goes to its file in a single write. Keep one emitter per builder so its buffer and stack are reused from
+    one program to the next
+
+    The same steps are public for builders that stream a program out as they derive it, instead of building the tree first
+*/
+class Emitter {
+
+    public:
+        Emitter(){
+            buffer.reserve(16 * 1024);
+        }
+
+        ~Emitter();
+
+        /// @brief Append the node and everything under it to the buffer
+        void emit(const Node& root);
+
+        /// @brief Append what is printed before the node's children, or all of it for nodes that never print their children, 
+        /// such as syntax. True if the children are printed
+        bool enter(const Node& node);
+
+        /// @brief Append everything under a node already entered
+        void emit_children(const Node& node);
+
+        /// @brief Call before each child of a node whose children are printed
+        inline void before_child(const Node& parent){
+            if(parent.layout == NL_DEFAULT) buffer.append(parent.indentation());
+        }
+
+        /// @brief Call after each child of a node whose children are printed
+        inline void after_child(const Node& parent){
+            if((parent.layout == NL_SPACE_AFTER) || (parent.layout == NL_SPACE_AROUND)) buffer.push_back(' ');
+        }
+
+        inline void append(std::string_view text){
+            buffer.append(text);
+        }
+
+        inline std::string_view view() const {return buffer;}
+
+        inline void clear(){buffer.clear();}
+
+        /// @brief Replace the file with the contents of the buffer
+        void write_file(const fs::path& path) const;
+
+        /// @brief Send everything appended from now on to the file, in chunks of `FLUSH_SIZE` or so, so that the buffer stays small
+        /// however long the program is. Nothing is kept in the buffer once the file is closed
+        void open_file(const fs::path& path);
+
+        /// @brief Write what is left and close the file
+        void close_file();
+
+        static constexpr size_t FLUSH_SIZE = 1024 * 1024;
+
+    private:
+        /// `next_link` is the node's next child in its table, or `Node_table::NONE` once there are none left
+        struct Frame {
+            const Node* node;
+            uint32_t next_link;
+            bool started;
+        };
+
+        void append_float(float num);
+
+        inline void maybe_flush(){
+            if((fd >= 0) && (buffer.size() >= FLUSH_SIZE)) flush();
+        }
+
+        void flush();
+
+        std::string buffer;
+        std::vector<Frame> stack;
+
+        int fd = -1;
+        fs::path file_path;
+};
+
+#endif
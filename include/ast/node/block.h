@@ -5,6 +5,7 @@
 #include <resource_definition.h>
 #include <resource.h>
 #include <collection.h>
+#include <free_list.h>
 
 /*
     Blocks contain external and internal qubits, external and internal bits, which are set targets that must be satisfied
@@ -37,8 +38,8 @@
                             project_z(qreg0[0])
                             cy(qreg0[0], 
 
-    the block set a target for internal qubits of 1, and external of 3. But since this is guppy, only internal definitions are created, and therefore this stalls in 
-    an infinite loop while picking a random qubit
+    the block set a target for internal qubits of 1, and external of 3. But since this is guppy, only internal definitions are created, and therefore the gate 
+    runs out of qubits to pick. Running out is an error, which abandons the program
 */
 
 class Block : public Node {
@@ -51,23 +52,23 @@ class Block : public Node {
         {}
 
         /// @brief Generating a random block from scratch
-        Block(std::string owner_name) :
+        Block(std::string owner_name, const Common::Limits& limits, std::mt19937& rng) :
             Node("block", Token::BLOCK),
             owner(owner_name), 
-            target_num_qubits_external(random_int(Common::MAX_QUBITS, Common::MIN_QUBITS)),
-            target_num_qubits_internal(random_int(Common::MAX_QUBITS, Common::MIN_QUBITS)),
-            target_num_bits_external(random_int(Common::MAX_BITS, Common::MIN_BITS)),
-            target_num_bits_internal(random_int(Common::MAX_BITS, Common::MIN_BITS)) 
+            target_num_qubits_external(random_int(rng, limits.max_qubits, limits.min_qubits)),
+            target_num_qubits_internal(random_int(rng, limits.max_qubits, limits.min_qubits)),
+            target_num_bits_external(random_int(rng, limits.max_bits, limits.min_bits)),
+            target_num_bits_internal(random_int(rng, limits.max_bits, limits.min_bits)) 
         {}
 
         /// @brief Generating a block with a specific number of external qubits (generating from DAG)
-        Block(std::string owner_name, unsigned int num_external_qubits) :
+        Block(std::string owner_name, unsigned int num_external_qubits, const Common::Limits& limits, std::mt19937& rng) :
             Node("block", Token::BLOCK),
             owner(owner_name), 
             target_num_qubits_external(num_external_qubits),
-            target_num_qubits_internal(random_int(Common::MAX_QUBITS, Common::MIN_QUBITS)),
-            target_num_bits_external(random_int(Common::MAX_BITS, Common::MIN_BITS)),
-            target_num_bits_internal(random_int(Common::MAX_BITS, Common::MIN_BITS)) 
+            target_num_qubits_internal(random_int(rng, limits.max_qubits, limits.min_qubits)),
+            target_num_bits_external(random_int(rng, limits.max_bits, limits.min_bits)),
+            target_num_bits_internal(random_int(rng, limits.max_bits, limits.min_bits)) 
         {}
 
         inline bool owned_by(std::string other){return other == owner;}
@@ -100,12 +101,14 @@ class Block : public Node {
             return bit_defs.get_num_of(scope);
         }
 
+        /// @brief Make every qubit available to the next gate
         void qubit_flag_reset(){
-            qubits.reset();
+            free_qubits.reset();
         }
 
+        /// @brief Make every bit available to the next gate
         void bit_flag_reset(){
-            bits.reset();
+            free_bits.reset();
         }
 
         void qubit_def_pointer_reset(){
@@ -132,41 +135,64 @@ class Block : public Node {
             }
         }
 
-        inline Collection<Resource::Qubit> get_qubits(){
+        inline const Collection<Resource::Qubit>& get_qubits() const {
             return qubits;
         }
 
-        inline Collection<Resource::Bit> get_bits(){
+        inline const Collection<Resource::Bit>& get_bits() const {
             return bits;
         }
 
-        inline Collection<Qubit_definition> get_qubit_defs(){
+        inline const Collection<Qubit_definition>& get_qubit_defs() const {
             return qubit_defs;
         }
 
-        inline Collection<Bit_definition> get_bit_defs(){
+        inline const Collection<Bit_definition>& get_bit_defs() const {
             return bit_defs;
         }
 
-        std::shared_ptr<Resource::Qubit> get_random_qubit(const U8& scope);
+        /// @brief A qubit in scope that hasn't been picked since the last reset, in constant time. The dummy qubit if the block has none 
+        /// in scope at all, throws if they have all been picked
+        std::shared_ptr<Resource::Qubit> get_random_qubit(std::mt19937& rng, const U8& scope);
         
-        std::shared_ptr<Resource::Bit> get_random_bit(const U8& scope);
+        /// @brief Same as `get_random_qubit`, for bits
+        std::shared_ptr<Resource::Bit> get_random_bit(std::mt19937& rng, const U8& scope);
+
+        /// @brief The qubit at `index`, which then counts as picked. Throws if the gate already picked it, or there is no such qubit
+        std::shared_ptr<Resource::Qubit> take_qubit(size_t index);
+
+        /// @brief Define exactly `n` qubits in each scope the block defines qubits in, instead of a random number of them
+        inline void set_target_num_qubits(unsigned int n){
+            target_num_qubits_external = n;
+            target_num_qubits_internal = n;
+        }
 
         std::shared_ptr<Qubit_definition> get_next_qubit_def(const U8& scope);
 
         std::shared_ptr<Bit_definition> get_next_bit_def(const U8& scope);
 
-        unsigned int make_register_resource_definition(unsigned int max_size, U8& scope, Resource::Classification classification, unsigned int& total_definitions);
+        unsigned int make_register_resource_definition(std::mt19937& rng, unsigned int max_size, U8& scope, Resource::Classification classification, unsigned int& total_definitions);
 
         unsigned int make_singular_resource_definition(U8& scope, Resource::Classification classification, unsigned int& total_definitions);
 
-        unsigned int make_resource_definitions(U8& scope, Resource::Classification classification);
+        unsigned int make_resource_definitions(std::mt19937& rng, U8& scope, Resource::Classification classification);
 
         unsigned int make_resource_definitions(const Dag::Dag& dag, const U8& scope, Resource::Classification classification);
 
-        void print_info() const;
+        void print_info(std::ostream& stream) const;
+
+        /// @brief Whether `resource` is one of the sentinels handed out when a block has nothing of the kind asked for
+        template<typename T>
+        static bool is_sentinel(const std::shared_ptr<T>& resource){
+            const void* ptr = resource.get();
+
+            return (ptr == dummy_qubit.get()) || (ptr == dummy_bit.get()) || (ptr == dummy_qubit_def.get()) || (ptr == dummy_bit_def.get());
+        }
 
     private:
+        /// @brief Start the free lists again over the block's current resources
+        void refresh_free_lists();
+
         std::string owner;
 
         unsigned int target_num_qubits_external = Common::MIN_QUBITS;
@@ -182,14 +208,23 @@ class Block : public Node {
         Collection<Resource::Bit> bits;
         Collection<Bit_definition> bit_defs;
 
+        /*
+            resources not yet picked by the gate being built, by index into `qubits` and `bits`
+        */
+        Free_list free_qubits;
+        Free_list free_bits;
+
         unsigned int qubit_def_pointer = 0;
         unsigned int bit_def_pointer = 0;
 
-        std::shared_ptr<Resource::Qubit> dummy_qubit = std::make_shared<Resource::Qubit>();
-        std::shared_ptr<Resource::Bit> dummy_bit = std::make_shared<Resource::Bit>();
+        /*
+            returned when a block has nothing of the kind asked for. Shared by every block built on a thread, so they are never changed
+        */
+        static thread_local const std::shared_ptr<Resource::Qubit> dummy_qubit;
+        static thread_local const std::shared_ptr<Resource::Bit> dummy_bit;
 
-        std::shared_ptr<Qubit_definition> dummy_qubit_def = std::make_shared<Qubit_definition>();
-        std::shared_ptr<Bit_definition> dummy_bit_def = std::make_shared<Bit_definition>();
+        static thread_local const std::shared_ptr<Qubit_definition> dummy_qubit_def;
+        static thread_local const std::shared_ptr<Bit_definition> dummy_bit_def;
 };
 
 
@@ -9,18 +9,18 @@ class Block;
 class Compound_stmt : public Node {
 
     public:
-        static std::shared_ptr<Compound_stmt> from_nested_depth(unsigned int nested_depth){
-            Compound_stmt stmt;
+        static Compound_stmt from_nested_depth(U8 indent_depth, unsigned int nested_depth){
+            Compound_stmt stmt(indent_depth);
             
             if(nested_depth == 0){
                 stmt.add_constraint(Token::QUBIT_OP, 1);
             }
 
-            return std::make_shared<Compound_stmt>(stmt);
+            return stmt;
         }
 
-        static std::shared_ptr<Compound_stmt> from_num_qubit_ops(unsigned int target_num_qubit_ops){
-            Compound_stmt stmt;
+        static Compound_stmt from_num_qubit_ops(U8 indent_depth, std::mt19937& rng, unsigned int target_num_qubit_ops){
+            Compound_stmt stmt(indent_depth);
 
             if(target_num_qubit_ops == 1){
                 /*
@@ -32,16 +32,16 @@ class Compound_stmt : public Node {
                 /*
                     use nesting block, target is > 1 
                 */
-                stmt.make_partition(target_num_qubit_ops, 1);
+                stmt.make_partition(rng, target_num_qubit_ops, 1);
                 stmt.add_constraint(Token::QUBIT_OP, 0);
             }
 
-            return std::make_shared<Compound_stmt>(stmt);
+            return stmt;
         }
 
     private:
-        Compound_stmt():
-            Node("compound_stmt", Token::COMPOUND_STMT, indentation_tracker)
+        Compound_stmt(U8 indent_depth):
+            Node("compound_stmt", Token::COMPOUND_STMT, indent_depth)
         {}
 };
 
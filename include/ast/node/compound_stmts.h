@@ -7,22 +7,23 @@ class Compound_stmts : public Node {
 
     public:
 
-        static std::shared_ptr<Compound_stmts> from_num_compound_stmts(unsigned int num_statements){
+        static Compound_stmts from_num_compound_stmts(unsigned int num_statements){
             Compound_stmts stmts;
             stmts.add_constraint(Token::COMPOUND_STMT, num_statements);
 
-            return std::make_shared<Compound_stmts>(stmts);
+            return stmts;
         }
 
-        static std::shared_ptr<Compound_stmts> from_num_qubit_ops(unsigned int target_num_qubit_ops){
+        /// @brief Statements sharing out `target_num_qubit_ops`, at most `max_statements` of them
+        static Compound_stmts from_num_qubit_ops(std::mt19937& rng, unsigned int target_num_qubit_ops, unsigned int max_statements){
             Compound_stmts stmts;
 
-            unsigned int n_children = (target_num_qubit_ops >= WILDCARD_MAX) ? WILDCARD_MAX : target_num_qubit_ops;
+            unsigned int n_children = std::min(target_num_qubit_ops, max_statements);
 
             stmts.add_constraint(Token::COMPOUND_STMT, n_children);
-            stmts.make_partition(target_num_qubit_ops, n_children);
+            stmts.make_partition(rng, target_num_qubit_ops, n_children);
             
-            return std::make_shared<Compound_stmts>(stmts);
+            return stmts;
         }
 
     private:
@@ -5,7 +5,7 @@
 
 
 /*
-    Used to override node print to add spaces after each child
+    Lays out its children with a space after each child
 */
 
 class Conjunction : public Node {
@@ -15,12 +15,7 @@ class Conjunction : public Node {
             Node("conjuction", Token::CONJUNCTION)         
         {
             add_constraint(Token::INVERSION, 2);
-        }
-
-        void print(std::ostream& stream) const override {
-            for(const std::shared_ptr<Node>& child : children){
-                stream << *child << " ";
-            } 
+            layout = NL_SPACE_AFTER;
         }
 
     private:
@@ -4,7 +4,7 @@
 #include <node.h>
 
 /*
-    Used to override node print to add spaces after each child
+    Lays out its children with a space after each child
 */
 
 class Disjunction : public Node {
@@ -14,12 +14,7 @@ class Disjunction : public Node {
             Node("disjunction", Token::DISJUNCTION)         
         {
             add_constraint(Token::CONJUNCTION, 2);
-        }
-
-        void print(std::ostream& stream) const override {
-            for(const std::shared_ptr<Node>& child : children){
-                stream << *child << " ";
-            } 
+            layout = NL_SPACE_AFTER;
         }
 
     private:
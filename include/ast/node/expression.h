@@ -4,7 +4,7 @@
 #include <node.h>
 
 /*
-    Used to override node print to add a space before each expression
+    Lays out a space before each expression
 */
 
 class Expression : public Node {
@@ -13,14 +13,8 @@ class Expression : public Node {
 
         Expression():
             Node("expression", Token::EXPRESSION)
-        {}
-
-        void print(std::ostream& stream) const override {
-            stream << " ";
-            
-            for(const std::shared_ptr<Node>& child : children){
-                stream << *child;
-            } 
+        {
+            layout = NL_SPACE_BEFORE;
         }
 
     private:
@@ -8,14 +8,17 @@ class Float : public Node {
     public:
         using Node::Node;
 
-        Float() :
-            Node(std::to_string(random_float(10)))
+        Float(std::mt19937& rng) :
+            Float(random_float(rng, 10))
         {}
 
+        /// @brief Formatted from `num` when emitted, so there is no content
         Float(float n) :
-            Node(std::to_string(n)),
+            Node(""),
             num(n)
-        {}
+        {
+            layout = NL_FLOAT;
+        }
 
         float get_num() const {return num;}
 
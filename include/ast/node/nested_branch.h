@@ -3,7 +3,7 @@
 
 /*
     elif and else make up this node type
-    these need to keep the indentation tracker in order to indent correctly
+    these need to keep the indentation depth they were made at in order to indent correctly
 */
 
 #include <node.h>
@@ -12,34 +12,29 @@ class Nested_branch : public Node {
 
     public:
 
-        Nested_branch(const std::string& str, const Token::Kind& kind, unsigned int target_num_qubit_ops):
-            Node(str, kind, indentation_tracker)
+        Nested_branch(const std::string& str, const Token::Kind& kind, U8 indent_depth, std::mt19937& rng, unsigned int target_num_qubit_ops):
+            Node(str, kind, indent_depth)
         {
+            layout = NL_INDENT_ONCE;
 
             if(kind == Token::ELIF_STMT){
                 /*
                     control flow branch with just compound stmts, or control flow branch with compound stmts and control flow branch
                 */
-                unsigned int n_children = (target_num_qubit_ops == 1) || random_int(1) ? 1 : 2;
+                unsigned int n_children = (target_num_qubit_ops == 1) || random_int(rng, 1) ? 1 : 2;
                 
-                make_control_flow_partition(target_num_qubit_ops, n_children);
+                make_control_flow_partition(rng, target_num_qubit_ops, n_children);
             
             } else if (kind == Token::ELSE_STMT){
                 // only one child we're interested in, which is compound stmts
-                make_control_flow_partition(target_num_qubit_ops, 1);
+                make_control_flow_partition(rng, target_num_qubit_ops, 1);
             }
         }
 
-        Nested_branch(const std::string& str, const Token::Kind& kind):
-            Node(str, kind, indentation_tracker)
-        {}
-
-        void print(std::ostream& stream) const override {
-            stream << indentation_str;
-
-            for(const std::shared_ptr<Node>& child : children){
-                stream << *child;
-            } 
+        Nested_branch(const std::string& str, const Token::Kind& kind, U8 indent_depth):
+            Node(str, kind, indent_depth)
+        {
+            layout = NL_INDENT_ONCE;
         }
 
     private:
@@ -10,15 +10,15 @@ class Nested_stmt : public Node {
             Node(str, kind)
         {}
     
-        Nested_stmt(const std::string& str, const Token::Kind& kind, unsigned int target_num_qubit_ops):
+        Nested_stmt(const std::string& str, const Token::Kind& kind, std::mt19937& rng, unsigned int target_num_qubit_ops):
             Node(str, kind)
         {
             /*
                 control flow with just compound stmts, or control flow with compound stmts and control flow branch
             */
-            unsigned int n_children = (target_num_qubit_ops == 1) || random_int(1) ? 1 : 2;
+            unsigned int n_children = (target_num_qubit_ops == 1) || random_int(rng, 1) ? 1 : 2;
 
-            make_control_flow_partition(target_num_qubit_ops, n_children);
+            make_control_flow_partition(rng, target_num_qubit_ops, n_children);
         }
 
     private:
@@ -1,100 +1,251 @@
 #ifndef NODE_H
 #define NODE_H
 
+#include <span>
+
 #include <utils.h>
-#include <branch.h>
+#include <ir.h>
+#include <node_table.h>
 
-enum Node_build_state {
+enum Node_build_state : U8 {
     NB_DONE,
     NB_BUILD,
 };
 
 
+/*
+    How a node's children are laid out when the program is emitted. Subclasses that need more than tabs between children pick one
+    of these in their constructor instead of overriding printing
+*/
+enum Node_layout : U8 {
+    NL_DEFAULT,             // syntax prints its content, anything else prints its children each after the indentation
+    NL_INDENT_ONCE,         // the indentation once, then the children
+    NL_SPACE_AFTER,         // each child followed by a space
+    NL_SPACE_BEFORE,        // a space, then the children
+    NL_SPACE_AROUND,        // a space, then each child followed by a space
+    NL_FLOAT,               // a float literal, formatted from its value when emitted
+};
+
+
 enum Node_kind {
     TERMINAL,
     NON_TERMINAL,
 };
 
 
+/*
+    Number of occurances required of each rule kind, kept as (kind, count) pairs. An empty constraint is no constraint. Nodes constrain
+    at most a couple of kinds, so that many pairs are kept in the constraint itself, and only longer ones, like a swarm testing
+    gateset, are allocated
+*/
 struct Node_constraint {
 
     public:
-        Node_constraint(Token::Kind rule, unsigned int _occurances):
-            rule_kinds({rule}),
-            occurances({_occurances})
-        {}
+        Node_constraint(){}
 
-        Node_constraint(std::vector<Token::Kind> _rule_kinds, std::vector<unsigned int> _occurances): 
-            rule_kinds(std::move(_rule_kinds)),
-            occurances(std::move(_occurances))
-        {}
+        Node_constraint(Token::Kind rule, unsigned int _occurances){
+            add(rule, _occurances);
+        }
+
+        Node_constraint(const std::vector<Token::Kind>& rule_kinds, const std::vector<unsigned int>& occurances){
+            size_t n = std::min(rule_kinds.size(), occurances.size());
+
+            reserve(n);
+
+            for(size_t i = 0; i < n; i++){
+                add(rule_kinds[i], occurances[i]);
+            }
+        }
+
+        Node_constraint(const Node_constraint& other){
+            reserve(other.n_entries);
+            std::copy_n(other.data(), other.n_entries, data());
+            n_entries = other.n_entries;
+        }
+
+        Node_constraint(Node_constraint&& other) noexcept {
+            take(other);
+        }
+
+        Node_constraint& operator=(const Node_constraint& other){
+            if(this != &other){
+                n_entries = 0;
+                reserve(other.n_entries);
+                std::copy_n(other.data(), other.n_entries, data());
+                n_entries = other.n_entries;
+            }
+
+            return *this;
+        }
+
+        Node_constraint& operator=(Node_constraint&& other) noexcept {
+            if(this != &other){
+                release();
+                take(other);
+            }
+
+            return *this;
+        }
 
-        bool passed(const Branch& branch){
-            // Count the number of occurances of each rule in the branch and return true if they match the expected occurances
-            for(size_t i = 0; i < rule_kinds.size(); i++){
-                if(branch.count_rule_occurances(rule_kinds[i]) != occurances[i]){
+        ~Node_constraint(){
+            release();
+        }
+
+        /// @brief Repetition counts for `branch` under which it meets the constraint, or nothing if it never can. Open ended repetitions
+        /// go up to `wildcard_max`
+        std::optional<std::vector<unsigned int>> solve(const Ir::Grammar& grammar, Ir::Index branch, std::mt19937& rng, unsigned int wildcard_max) const {
+            if(grammar.branch(branch).n_repetitions == 0){
+                // Count the number of occurances of each rule in the branch and check they match the expected occurances
+                for(const Ir::Kind_count& entry : entries()){
+                    if(grammar.count_rule_occurances(branch, entry.kind) != entry.count){
+                        return std::nullopt;
+                    }
+                }
+
+                return std::vector<unsigned int>{};
+            }
+
+            return grammar.solve_repetitions(branch, entries(), rng, wildcard_max);
+        }
+
+        /// @brief Cheap check against the bounds on each kind's occurances in the branch. Exact for branches without repetitions, otherwise 
+        /// only rules out branches that can never meet the constraint
+        bool may_pass(const Ir::Grammar& grammar, Ir::Index branch) const {
+            for(const Ir::Kind_count& entry : entries()){
+                U64 fixed = grammar.count_rule_occurances(branch, entry.kind);
+
+                if((fixed > entry.count) || (fixed + grammar.max_repeated_occurances(branch, entry.kind) < entry.count)){
                     return false;
                 }
             }
+
             return true;
         }
 
+        /// @brief Identifies the constraint in a rule's index of satisfying branches
+        std::vector<unsigned int> key() const {
+            std::vector<unsigned int> out;
+            out.reserve(2 * n_entries);
+
+            for(const Ir::Kind_count& entry : entries()){
+                out.push_back(entry.kind);
+                out.push_back(entry.count);
+            }
+
+            return out;
+        }
+
         Token::Kind get_rule_kind_at(unsigned int index) const {
-            return rule_kinds[index];
+            return data()[index].kind;
         }
 
         unsigned int get_occurances_at(unsigned int index) const {
-            return occurances[index];
+            return data()[index].count;
         }
 
         unsigned int size() const {
-            return rule_kinds.size();
+            return n_entries;
+        }
+
+        bool empty() const {
+            return n_entries == 0;
         }
 
         void add(const Token::Kind& rule, unsigned int n_occurances){
-            rule_kinds.push_back(rule);
-            occurances.push_back(n_occurances);    
+            if(n_entries == capacity) reserve(2 * capacity);
+
+            data()[n_entries++] = Ir::Kind_count{.kind = rule, .count = n_occurances};
+        }
+
+        inline std::span<const Ir::Kind_count> entries() const {
+            return std::span<const Ir::Kind_count>(data(), n_entries);
         }
 
     private:
-        std::vector<Token::Kind> rule_kinds;
-        std::vector<unsigned int> occurances = {0};
+        static constexpr uint32_t INLINE_ENTRIES = 2;
+
+        inline bool spilled() const {
+            return capacity > INLINE_ENTRIES;
+        }
+
+        inline Ir::Kind_count* data(){
+            return spilled() ? heap_entries : inline_entries;
+        }
+
+        inline const Ir::Kind_count* data() const {
+            return spilled() ? heap_entries : inline_entries;
+        }
+
+        /// @brief Room for at least `n` entries, keeping the ones already there
+        void reserve(size_t n){
+            if(n <= capacity) return;
+
+            Ir::Kind_count* grown = new Ir::Kind_count[n];
+            std::copy_n(data(), n_entries, grown);
+
+            release();
+
+            heap_entries = grown;
+            capacity = n;
+        }
+
+        void release(){
+            if(spilled()) delete[] heap_entries;
+
+            capacity = INLINE_ENTRIES;
+        }
+
+        /// @brief Move `other`'s entries in, leaving it empty. Expects nothing to be allocated here
+        void take(Node_constraint& other){
+            n_entries = other.n_entries;
+            capacity = other.capacity;
+
+            if(other.spilled()){
+                heap_entries = other.heap_entries;
+            } else {
+                std::copy_n(other.inline_entries, n_entries, inline_entries);
+            }
+
+            other.n_entries = 0;
+            other.capacity = INLINE_ENTRIES;
+        }
+
+        uint32_t n_entries = 0;
+        uint32_t capacity = INLINE_ENTRIES;
+
+        union {
+            Ir::Kind_count inline_entries[INLINE_ENTRIES];
+            Ir::Kind_count* heap_entries;
+        };
 
 };
 
 
+class Emitter;
+
 /// @brief A node is a term with pointers to other nodes
 class Node {
 
     public:
-        static std::string indentation_tracker;
-        static int node_counter;
 
         Node(){}
 
-        Node(std::string _content, Token::Kind _kind = Token::SYNTAX, const std::string _indentation_str = ""):
-            content(_content),
+        /// @brief `_indent_depth` is the number of tabs printed before each child
+        Node(std::string _content, Token::Kind _kind = Token::SYNTAX, U8 _indent_depth = 0):
+            content(std::move(_content)),
             kind(_kind),
-            indentation_str(_indentation_str)
-        {
-            id = node_counter++;
-        }
+            indent_depth(_indent_depth)
+        {}
 
-        Node(std::string _content, Token::Kind _kind, const std::optional<Node_constraint>& _constraint, const std::string _indentation_str = ""):
-            content(_content),
+        Node(std::string _content, Token::Kind _kind, const std::optional<Node_constraint>& _constraint, U8 _indent_depth = 0):
+            content(std::move(_content)),
             kind(_kind),
-            indentation_str(_indentation_str),
-            constraint(_constraint)
-        {
-            id = node_counter++;
-        }
+            indent_depth(_indent_depth),
+            constraint(_constraint.value_or(Node_constraint()))
+        {}
 
         virtual ~Node() = default;
 
-        inline void add_child(const std::shared_ptr<Node> child){
-            children.push_back(child);
-        }
-
         void transition_to_done(){
             state = NB_DONE;
         }
@@ -113,42 +264,27 @@ class Node {
             return id;
         }
 
+        /// @brief Ids are handed out by the context building the program, nodes made outside of one keep -1
+        inline void set_id(int _id){
+            id = _id;
+        }
+
         virtual std::string resolved_name() const {
             return content + ", id: " + std::to_string(id);
         }
 
         // Node_kind get_node_kind() const {return kind;}
 
-        virtual void print(std::ostream& stream) const {
-            if(kind == Token::SYNTAX){
-                stream << content;
-            } else {
-
-                for(const std::shared_ptr<Node>& child : children){
-                    stream << indentation_str << *child;
-                }
-            }
-        }
+        /// @brief Emits the node and everything under it, see `Emitter`
+        void print(std::ostream& stream) const;
 
         friend std::ostream& operator<<(std::ostream& stream, const Node& n) {
             n.print(stream);
             return stream;
         }
 
-        std::vector<std::shared_ptr<Node>> get_children() const {
-            return children;
-        }
-
-        inline std::shared_ptr<Node> child_at(size_t index) const {
-            if(index < children.size()){
-                return children.at(index);
-            } else {
-                return nullptr;
-            }
-        }
-
         size_t get_num_children() const {
-            return children.size();
+            return (table == nullptr) ? 0 : table->n_children(row);
         }
 
         bool operator==(const Token::Kind& other_kind){
@@ -159,56 +295,68 @@ class Node {
         //     return string == other;
         // }
 
-        bool branch_satisfies_constraint(const Branch& branch){
-            return !constraint.has_value() || constraint.value().passed(branch);
-        }
+        /// @brief Nothing if the node doesn't constrain its children
+        const Node_constraint* get_constraint() const {return constraint.empty() ? nullptr : &constraint;}
 
         void set_constraint(std::vector<Token::Kind> rule_kinds, std::vector<unsigned int> occurances){
             if(rule_kinds.size() != occurances.size()){
                 ERROR("Hashes vector must be the same size as occurances vector!");
             }
 
-            constraint = std::make_optional<Node_constraint>(rule_kinds, occurances);
+            constraint = Node_constraint(rule_kinds, occurances);
         }
 
         void add_constraint(const Token::Kind& rule_kind, unsigned int n_occurances){
-            if(constraint.has_value()){
-                constraint.value().add(rule_kind, n_occurances);
-            } else {
-                constraint = std::make_optional<Node_constraint>(rule_kind, n_occurances);
-            }
+            constraint.add(rule_kind, n_occurances);
         }
 
-        #ifdef DEBUG
         std::string get_debug_constraint_string() const;
-        #endif
 
         virtual unsigned int get_n_ports() const {return 1;}
 
+        /// @brief Whether the node holds on to what it derived when a program is streamed out rather than kept as a tree. Nodes that
+        /// are handed out more than once must, so that they print the same every time
+        virtual bool keeps_children() const {return false;}
+
         // std::shared_ptr<Node> find(const U64 _hash) const;
 
         int get_next_child_target();
 
-        void make_partition(int target, int n_children);
+        void make_partition(std::mt19937& rng, int target, int n_children);
 
-        void make_control_flow_partition(int target, int n_children);
+        void make_control_flow_partition(std::mt19937& rng, int target, int n_children);
 
     protected:
+        /// @brief Tabs the node's children are printed after, a view of one shared string
+        inline std::string_view indentation() const {
+            static const std::string tabs(UINT8_MAX, '\t');
+            return std::string_view(tabs).substr(0, indent_depth);
+        }
+
         std::string content;
         Token::Kind kind;
 
         // Node_kind kind;
-        int id;
+        int id = -1;
 
-        std::string indentation_str;
-        std::vector<std::shared_ptr<Node>> children;
+        U8 indent_depth = 0;
         Node_build_state state = NB_BUILD;
+        Node_layout layout = NL_DEFAULT;
 
         std::vector<int> child_partition;
         unsigned int partition_counter = 0;
     
     private:
-        std::optional<Node_constraint> constraint;
+        friend class Emitter;
+        friend class Node_table;
+
+        /*
+            where the node's children are, if it has any. Its row is in the table of the program it got them in
+        */
+        uint32_t row = Node_table::NONE;
+        const Node_table* table = nullptr;
+
+        Node_constraint constraint;
 };
 
 #endif
@@ -19,7 +19,8 @@ class Qubit_op : public Node {
             gate_node = std::make_optional<std::shared_ptr<Node>>(node);
         }
 
-        void add_gate_if_subroutine(std::vector<std::shared_ptr<Node>>& subroutine_gates);
+        /// @brief Add the gate to `subroutine_gates` if it is a subroutine whose name isn't in `subroutine_names` yet
+        void add_gate_if_subroutine(std::vector<std::shared_ptr<Node>>& subroutine_gates, std::unordered_set<std::string>& subroutine_names);
 
         std::string resolved_name() const override;
 
@@ -20,12 +20,6 @@ class Register_resource : public Node {
             index(_index)
         {}
 
-        void reset(){used = false;}
-
-        void set_used(){used = true;}
-        
-        bool is_used(){return used;}
-
         inline std::shared_ptr<Variable> get_name() const {
             return std::make_shared<Variable>(name);
         }
@@ -37,7 +31,6 @@ class Register_resource : public Node {
     private:
         Variable name;
         Integer index;
-        bool used = false;
 };
 
 class Register_qubit : public Register_resource {
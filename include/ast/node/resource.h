@@ -38,24 +38,6 @@ namespace Resource {
                 return scope;
             }
 
-            void reset(){
-                std::visit([](auto&& val){
-                    val.reset();
-                }, value);
-            }
-
-            bool is_used(){
-                return std::visit([](auto&& val) -> bool {
-                    return val.is_used();
-                }, value);
-            }
-
-            void set_used(){
-                std::visit([](auto&& val){
-                    val.set_used();
-                }, value);
-            }
-
             inline std::shared_ptr<Variable> get_name() const {
                 return std::visit([](auto&& val) -> std::shared_ptr<Variable> {
                     return val.get_name();
@@ -78,6 +60,8 @@ namespace Resource {
 
             std::string resolved_name() const override;
 
+            /// @brief The same resource is named by every operation on it, and is only derived the first time
+            bool keeps_children() const override {return true;}
             
             
         private:
@@ -7,8 +7,8 @@ class Qubit_defs : public Node {
 
     public:
 
-        Qubit_defs(unsigned int num_defs):
-            Node("qubit_defs", Token::QUBIT_DEFS, indentation_tracker)
+        Qubit_defs(U8 indent_depth, unsigned int num_defs):
+            Node("qubit_defs", Token::QUBIT_DEFS, indent_depth)
         {
             add_constraint(Token::QUBIT_DEF, num_defs);
         }
@@ -21,8 +21,8 @@ class Bit_defs : public Node {
 
     public:
 
-        Bit_defs(unsigned int num_defs):
-            Node("bit_defs", Token::BIT_DEFS, indentation_tracker)
+        Bit_defs(U8 indent_depth, unsigned int num_defs):
+            Node("bit_defs", Token::BIT_DEFS, indent_depth)
         {
             add_constraint(Token::BIT_DEF, num_defs);
         }
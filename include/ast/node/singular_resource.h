@@ -16,19 +16,12 @@ class Singular_resource : public Node {
             name(_name)
         {}
 
-        void reset(){used = false;}
-
-        void set_used(){used = true;}
-        
-        bool is_used(){return used;}
-
         inline std::shared_ptr<Variable> get_name() const {
             return std::make_shared<Variable>(name);
         }
         
     private:
         Variable name;
-        bool used = false;
 };
 
 class Singular_qubit : public Singular_resource {
@@ -0,0 +1,51 @@
+#ifndef NODE_TABLE_H
+#define NODE_TABLE_H
+
+#include <utils.h>
+
+class Node;
+
+/*
+    The shape of one program's tree, kept in flat columns rather than in each node. A node that gets children is given a row,
+    holding the first and last of its child links and how many there are. Each link is an entry in the columns of its own, with
+    the child and the next link under the same parent, so a node placed under several parents, like a resource, has a link under
+    each without being copied. The table owns the children, so it has to outlive every walk of the tree. The program, and the DAG
+    of any genome made from it, hold on to it for that
+*/
+class Node_table {
+
+    public:
+        static constexpr uint32_t NONE = UINT32_MAX;
+
+        Node_table(){}
+
+        /// @brief Link `child` last under `parent`, giving the parent a row here if it has none yet
+        void add_child(Node& parent, std::shared_ptr<Node> child);
+
+        inline uint32_t n_children(uint32_t row) const {return rows[row].n_children;}
+
+        /// @brief Link of the row's first child, `NONE` if it has none
+        inline uint32_t first_child(uint32_t row) const {return rows[row].first_link;}
+
+        /// @brief Link of the next child under the same parent, `NONE` after the last
+        inline uint32_t next_sibling(uint32_t link) const {return next_links[link];}
+
+        inline const Node& child(uint32_t link) const {return *children[link];}
+
+    private:
+        struct Row {
+            uint32_t first_link;
+            uint32_t last_link;
+            uint32_t n_children;
+        };
+
+        std::vector<Row> rows;
+
+        /*
+            links, by index
+        */
+        std::vector<std::shared_ptr<Node>> children;
+        std::vector<uint32_t> next_links;
+};
+
+#endif
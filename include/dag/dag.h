@@ -60,6 +60,16 @@ namespace Dag {
         }
     };
 
+    /// @brief Qubit op at the open end of some qubit's path in a streamed DAG, i.e one that can still gain children
+    struct Open_node{
+        std::shared_ptr<Qubit_op> node;
+
+        unsigned int out_degree = 0;
+        unsigned int depth = 1; // qubit ops on the longest path ending at this one
+        unsigned int n_open_paths = 0; // qubits whose path currently ends here
+        bool in_dag = false;
+    };
+
     /// @brief Given a set of qubits, get DAG score using the path taken by each qubit
     class Dag {
         
@@ -68,32 +78,44 @@ namespace Dag {
 
             void make_dag(const std::shared_ptr<Block> block);
 
-            inline Collection<Qubit_definition> get_qubit_defs() const {
+            inline const Collection<Qubit_definition>& get_qubit_defs() const {
                 return qubit_defs;
             }
 
-            inline Collection<Bit_definition> get_bit_defs() const {
+            inline const Collection<Bit_definition>& get_bit_defs() const {
                 return bit_defs;
             }
 
-            inline Collection<Resource::Qubit> get_qubits() const {
+            inline const Collection<Resource::Qubit>& get_qubits() const {
                 return qubits;
             }
 
-            inline Collection<Resource::Bit> get_bits() const {
+            inline const Collection<Resource::Bit>& get_bits() const {
                 return bits;
             }
 
             void add_edge(const Edge& edge, std::optional<int> maybe_dest_node_id, int qubit_id);
 
-            void render_dag(const fs::path& current_circuit_dir);
+            /*
+                a streamed program lets go of its qubit ops as they are printed, so its DAG is never built out of flow paths. Each
+                qubit op is added as it is put on a qubit instead, and only the stats are kept, along with the ops some qubit's path
+                still ends at. That is at most one per qubit, however long the program gets
+            */
+
+            /// @brief Put `node` at the end of the path of `qubit`
+            void extend(const Resource::Qubit& qubit, const std::shared_ptr<Qubit_op>& node);
+
+            void render_dag(const fs::path& current_circuit_dir, bool verbose = false);
+
+            int max_out_degree() const;
 
-            int max_out_degree();
+            /// @brief Number of qubit ops on the longest path through the DAG
+            unsigned int depth() const;
 
-            int score();
+            int score() const;
 
             unsigned int n_qubit_ops() const {
-                return nodewise_data.size();
+                return streamed ? streamed_n_nodes : nodewise_data.size();
             }
 
             unsigned int n_subroutines() const {
@@ -127,6 +149,10 @@ namespace Dag {
                 stream << "N_NODES (all nodes are Qubit_ops): " << dag.n_qubit_ops() << std::endl;
                 stream << "N_SUBROUTINES: " << dag.n_subroutines() << std::endl;
 
+                if(dag.streamed){
+                    stream << "MAX_OUT_DEGREE: " << dag.max_out_degree() << ", DEPTH: " << dag.depth() << " (streamed, nodes not kept)" << std::endl;
+                }
+
                 for(const auto& node_data : dag.nodewise_data){
 
                     stream << node_data.node->get_id() << " -> children: ";
@@ -141,19 +167,54 @@ namespace Dag {
                 return stream;
             }
 
+            /// @brief Hold on to the table of the program the qubit ops are from, so that they can still be printed in programs 
+            /// made from this DAG after that one is gone
+            inline void keep_nodes(std::shared_ptr<const Node_table> table){
+                nodes = std::move(table);
+            }
+
             inline void reset(){
+                nodes.reset();
                 nodewise_data.clear();
+                node_positions.clear();
                 node_pointer = 0;
                 subroutine_gates.clear();
+                subroutine_names.clear();
                 sub_pointer = 0;
+
+                streamed = false;
+                path_ends.clear();
+                open_nodes.clear();
+                streamed_n_nodes = 0;
+                streamed_max_out_degree = 0;
+                streamed_depth = 0;
             }
 
         private:
+            std::shared_ptr<const Node_table> nodes;
             std::vector<Node_data> nodewise_data;
             unsigned int node_pointer = 0;
             std::vector<std::shared_ptr<Node>> subroutine_gates;
             unsigned int sub_pointer = 0;
 
+            /*
+                position of each node in `nodewise_data` by node id, and the names of the subroutines in `subroutine_gates`, so
+                adding an edge never has to look through every node or subroutine seen so far
+            */
+            std::unordered_map<int, unsigned int> node_positions;
+            std::unordered_set<std::string> subroutine_names;
+
+            /*
+                what a streamed DAG keeps: the id of the qubit op each qubit's path ends at, those qubit ops by id, and the stats.
+                Qubits are told apart by address, as those a block defines don't all have ids of their own
+            */
+            bool streamed = false;
+            std::unordered_map<const Resource::Qubit*, int> path_ends;
+            std::unordered_map<int, Open_node> open_nodes;
+            unsigned int streamed_n_nodes = 0;
+            unsigned int streamed_max_out_degree = 0;
+            unsigned int streamed_depth = 0;
+
             Collection<Resource::Qubit> qubits;
             Collection<Qubit_definition> qubit_defs;
             
@@ -1,7 +1,11 @@
 #ifndef GENERATOR_H
 #define GENERATOR_H
 
-#include <grammar.h>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+#include <ir.h>
 #include <ast.h>
 #include <genome.h>
 #include <dag.h>
@@ -10,14 +14,16 @@ struct Generator {
 
     public:
 
-        Generator(Grammar& _grammar): 
-            grammar(std::make_shared<Grammar>(_grammar)),
+        Generator(const std::shared_ptr<const Ir::Grammar> _grammar): 
+            grammar(_grammar),
             builder(std::make_shared<Ast>())
         {}
 
         void setup_builder(const std::string& entry_name, const U8& scope);
 
-        friend std::ostream& operator<<(std::ostream& stream, Generator generator){
+        inline bool entry_set() const {return builder->entry_set();}
+
+        friend std::ostream& operator<<(std::ostream& stream, const Generator& generator){
             stream << "  . " << generator.grammar->get_name() << ": ";
             generator.grammar->print_rules();
 
@@ -32,7 +38,36 @@ struct Generator {
             grammar->print_tokens();
         }
 
-        inline std::shared_ptr<Grammar> get_grammar() const { return grammar; }
+        void print_analysis(){
+            grammar->print_analysis(std::cout, builder->get_entry());
+        }
+
+        /// @brief Override the weight of a branch of every rule with this name, until reset. A reload keeps it as long as the rule 
+        /// still has the branch
+        void set_weight(const std::string& rule_name, unsigned int branch, float weight);
+
+        inline void reset_weights(){
+            std::lock_guard<std::mutex> lock(weights_mutex);
+
+            weights.clear();
+            builder->reset_weights();
+        }
+
+        /// @brief Take over the weights set on the generator of the grammar before it was reloaded, returning how many there are. They 
+        /// are set on this grammar's rules once an entry is
+        inline size_t carry_weights(Generator& previous){
+            std::scoped_lock lock(weights_mutex, previous.weights_mutex);
+            weights = previous.weights;
+
+            return weights.size();
+        }
+
+        /// @brief Limits on the size of every program generated from here on
+        inline void set_limits(const Common::Limits& limits){builder->set_limits(limits);}
+
+        inline const Common::Limits& get_limits() const {return builder->get_limits();}
+
+        inline std::shared_ptr<const Ir::Grammar> get_grammar() const { return grammar; }
 
         Dag::Dag crossover(const Dag::Dag& dag1, const Dag::Dag& dag2);
 
@@ -40,19 +75,48 @@ struct Generator {
 
         std::vector<Token::Kind> get_available_gates();
 
-        Node_constraint get_swarm_testing_gateset();
+        Node_constraint get_swarm_testing_gateset(std::mt19937& rng);
+
+        void ast_to_program(fs::path output_dir, int build_counter, std::optional<Genome>&& genome, const Common::Flags& flags);
 
-        void ast_to_program(fs::path output_dir, int build_counter, std::optional<Genome> genome);
+        void generate_random_programs(fs::path output_dir, int n_programs, U64 master_seed, U64 first_program, const Common::Flags& flags);
 
-        void generate_random_programs(fs::path output_dir, int n_programs);
+        /// @brief Build the one program generated from `seed` again, into `circuit_dir`. Only the same grammar, entry, weights and 
+        /// flags give the same program
+        void replay(fs::path circuit_dir, int build_counter, U64 seed, const Common::Flags& flags);
 
-        void run_genetic(fs::path output_dir, int population_size);
+        void run_genetic(fs::path output_dir, int population_size, U64 master_seed, const Common::Flags& flags);
 
 
     private:
-        std::shared_ptr<Grammar> grammar;
+        /*
+            a weight set from the REPL, by rule name so that it can be set again on a reloaded grammar
+        */
+        struct Weight {
+            std::string rule_name;
+            unsigned int branch;
+            float weight;
+        };
+
+        /// @brief Set the weight on every rule with this name that has the branch, returning whether any did. With `report`, rules 
+        /// without the branch, or no rule of that name, are reported
+        bool apply_weight(const Weight& weight, bool report);
+
+        /// @brief Build a program into `current_circuit_dir`. With a seed, the builder is seeded with it first and it is written to seed.txt.
+        /// A `genome` is moved into the build, its DAG ends up with the program
+        void ast_to_program(Ast& ast, fs::path current_circuit_dir, int build_counter, std::optional<Genome>&& genome, std::optional<U64> seed, const Common::Flags& flags);
+
+        std::shared_ptr<const Ir::Grammar> grammar;
         std::shared_ptr<Ast> builder;
 
+        std::mutex output_mutex;
+
+        /*
+            every weight set and not reset, which the watcher thread reads when it reloads the grammar
+        */
+        std::mutex weights_mutex;
+        std::vector<Weight> weights;
+
         int n_epochs = 100;
         float elitism = 0.2;
 
@@ -3,21 +3,6 @@
 
 #include <term.h>
 
-struct Branch_multiply {
-    std::vector<Term> remainders;
-    std::vector<Term> mults;
-
-    bool is_empty(){
-        return remainders.empty() && mults.empty();
-    }
-
-    void clear(){
-        remainders.clear();
-        mults.clear();
-    }
-
-};
-
 class Branch {
 
     public:
@@ -36,36 +21,36 @@ class Branch {
 
         inline void set_recursive_flag(){recursive = true;}
 
+        /// @brief Relative chance of the branch being picked among the branches of its rule
+        inline float get_weight() const {return weight;}
+
+        inline void set_weight(float _weight){weight = _weight;}
+
         void add(const Term& term);
 
+        /// @brief Remove the last term and return it
+        Term take_last();
+
         size_t size() const {return terms.size();}
 
         const Term& at(size_t index) const {return terms.at(index);}
 
         Term& at(size_t index) {return terms.at(index);}
 
-        unsigned int count_rule_occurances(const Token::Kind& kind) const {
-
-            unsigned int out = 0;
-
-            for(const Term& term : terms){
-                out += (term.is_rule()) && (term.get_kind() == kind);
-            }
-
-            return out;
-        }
+        /// @brief Number of repetitions in the branch, counting those nested inside other repetitions
+        size_t num_repetitions() const {return n_repetitions;}
 
         bool is_empty() const {return terms.empty();}
 
-        std::vector<Term> get_terms() const {return terms;} 
-
-        void setup_basis(Branch_multiply& basis, unsigned int nesting_depth) const;
+        const std::vector<Term>& get_terms() const {return terms;} 
 
         friend std::ostream& operator<<(std::ostream& stream, const Branch& branch){
             for(const auto& elem : branch.terms){
                 stream << elem << " ";
             }
 
+            if(branch.weight != 1.0f) stream << "@" << branch.weight << " ";
+
             return stream;
         }
 
@@ -88,6 +73,10 @@ class Branch {
     private:
         bool recursive = false;
 
+        float weight = 1.0f;
+
+        size_t n_repetitions = 0;
+
         std::vector<Term> terms;
 };
 
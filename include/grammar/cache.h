@@ -0,0 +1,40 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <ir.h>
+
+/*
+    On-disk cache of frozen grammars. A cache file is keyed by a hash of the grammar file, the meta-grammar, the token kinds and the 
+    format version, so it is rebuilt whenever any of them change. The file is just the tables of the `Ir::Grammar` written out back to 
+    back, so loading reads each table straight into place, without lexing or parsing anything
+
+    Layout: Header | Ir::Rule[n_rules] | Ir::Branch[n_branches] | Ir::Term[n_terms] | Ir::Kind_count[n_kind_counts] | 
+            Ir::Kind_count[n_repeated_kinds] | Ir::String[n_strings] | arena bytes
+*/
+
+namespace Cache {
+
+    constexpr char MAGIC[4] = {'Q', 'F', 'G', 'C'};
+    constexpr uint32_t VERSION = 7;
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        U64 key;
+        uint32_t n_rules;
+        uint32_t n_branches;
+        uint32_t n_terms;
+        uint32_t n_kind_counts;
+        uint32_t n_repeated_kinds;
+        uint32_t n_strings;
+        uint32_t n_arena_bytes;
+    };
+
+    U64 key(const fs::path& grammar_path, U64 meta_grammar_hash);
+
+    std::optional<Ir::Grammar> load(const fs::path& grammar_path, const fs::path& cache_path, U64 key);
+
+    void save(const Ir::Grammar& grammar, const fs::path& cache_path, U64 key);
+}
+
+#endif
@@ -9,12 +9,18 @@
 #include <cctype>
 #include <algorithm>
 
+/*
+    The meta grammar is built once on its own, and every other grammar is an overlay on top of it. An overlay only parses its own file,
+    looks up rules in the base before its own, and leaves the base untouched: a base rule it overrides (`=`) or appends to (`+=`) is
+    shadowed by a copy that only the overlay sees. Base rules it doesn't touch are shared by every overlay
+*/
 class Grammar{
 
     public:
         Grammar(){}
 
-        Grammar(const fs::path& filename, std::vector<Token::Token>& meta_grammar_tokens);
+        /// @brief Grammar for the file, layered over `_base` if there is one
+        Grammar(const fs::path& filename, std::shared_ptr<const Grammar> _base = nullptr);
 
         void consume(int n);
 
@@ -22,47 +28,43 @@ class Grammar{
 
         void peek();
 
-        std::shared_ptr<Rule> get_rule_pointer_if_exists(const std::string& name, const U8& scope = NO_SCOPE);
+        std::shared_ptr<Rule> get_rule_pointer_if_exists(const std::string& name, const U8& scope = NO_SCOPE) const;
 
         std::shared_ptr<Rule> get_rule_pointer(const Token::Token& token, const U8& scope = NO_SCOPE);
 
-        inline void reset_current_branches(){current_branches.clear();}
-        
-        inline void add_current_branches_to_rule(){
-
-            if(current_branches.size() == 0){
-                current_rule->add(Branch());
-                
-            } else {
-
-                for(Branch& current_branch : current_branches){
-                    #if 0
-                    std::cout << "Lazily adding ";
-                    current_branch.print(std::cout);
-                    std::cout << std::endl;
-                    #endif
-
-                    current_rule->add(current_branch);
-                }
-            }
+        /// @brief Rule that a definition of `token` writes to. Base rules are shadowed by a copy first
+        std::shared_ptr<Rule> get_rule_to_define(const Token::Token& token, const U8& scope);
+
+        /// @brief The rule that stands in for `rule` in this grammar, which is its shadow if the base rule was shadowed
+        inline std::shared_ptr<Rule> resolve(const std::shared_ptr<Rule>& rule) const {
+            auto it = shadows.find(rule.get());
+            return (it == shadows.end()) ? rule : it->second;
         }
 
-        /// we just completed a rule, add the current branch to the rule
-        /// Called at end of rule, and at each branch seprator
-        inline void complete_rule(){
-            add_current_branches_to_rule();
+        void index_rule(const std::shared_ptr<Rule>& rule);
+
+        inline void add_rule(const std::shared_ptr<Rule>& rule){
+            rule_pointers.push_back(rule);
+            index_rule(rule);
         }
 
-        inline void increment_nesting_depth_base(){
-            if(nesting_depth == nesting_depth_base) {
-                nesting_depth_base += 1;
-                nesting_depth = nesting_depth_base;
-            }
+        /// @brief Rules of the base, with shadowed ones swapped for their shadows, followed by the rules this grammar adds
+        inline const std::vector<std::shared_ptr<Rule>>& get_rules() const {return rule_pointers;}
+
+        /// @brief Groups opened by `(` collect terms until they are closed, everything else goes straight into the current branch
+        inline Branch& current_sequence(){
+            return open_groups.empty() ? current_branch : open_groups.back();
         }
 
-        void extend_current_branches(const Token::Token& wildcard);
+        /// we just completed a branch, add it to the rule
+        /// Called at end of rule, and at each branch seprator
+        void complete_branch();
+
+        void close_group();
+
+        void add_repetition(const Token::Token& wildcard);
 
-        void add_term_to_current_branches(const Token::Token& tokens);
+        void set_weight(const Token::Token& weight);
 
         void add_term_to_branch(const Token::Token& token, Branch& branch);
 
@@ -76,23 +78,21 @@ class Grammar{
             return stream;
         }
 
-        void print_rules() const;
+        inline std::string get_name() const {return name;}
 
-        void print_tokens() const;
-
-        inline bool is_rule(const std::string& rule_name, const U8& scope){
-            for(const auto& ptr : rule_pointers){
-                if((ptr->get_name() == rule_name) && (ptr->get_scope() == scope)){return true;}
-            }
+        inline std::string get_path() const {return path.string();}
+    
+    private:
+        /// @brief Find a rule, base first. `shared` is set if it is a base rule that hasn't been shadowed
+        std::shared_ptr<Rule> find_rule(const std::string& name, const U8& scope, bool& shared) const;
 
-            return false;            
-        }
+        std::shared_ptr<const Grammar> base = nullptr;
 
-        inline std::string get_name(){return name;}
+        /*
+            base rule -> the copy of it this overlay defines instead
+        */
+        std::unordered_map<const Rule*, std::shared_ptr<Rule>> shadows;
 
-        inline std::string get_path(){return path.string();}
-    
-    private:
         std::vector<Token::Token> tokens;
         size_t num_tokens = 0;
         size_t token_pointer = 0;
@@ -100,20 +100,22 @@ class Grammar{
         Result<Token::Token> next_token;
         Token::Token prev_token;
 
-        std::string range_start = "", range_end = "";
-
-        std::vector<Branch> current_branches;
+        Branch current_branch;
+        std::vector<Branch> open_groups;
+        std::optional<Branch> closed_group;
         std::shared_ptr<Rule> current_rule = nullptr;
 
         U8 rule_def_scope = NO_SCOPE;
         U8 rule_decl_scope = NO_SCOPE;
 
-        unsigned int nesting_depth_base = 0;
-        unsigned int nesting_depth = nesting_depth_base;
-
         std::vector<std::shared_ptr<Rule>> rule_pointers;
+
+        /*
+            rules this grammar adds are found by (name, scope). A lookup scope matches every rule scope it shares a flag with, so each rule is indexed under 
+            every lookup scope it matches, keeping the first rule added for each slot as a scan over `rule_pointers` would
+        */
+        std::unordered_map<std::string, std::array<std::shared_ptr<Rule>, ALL_SCOPES + 1>> rule_index;
         
-        Lexer::Lexer lexer;
         std::string name;
         fs::path path;
 };
@@ -0,0 +1,243 @@
+#ifndef IR_H
+#define IR_H
+
+#include <span>
+
+#include <grammar.h>
+#include <alias_table.h>
+
+/*
+    Frozen form of a built grammar, which is what generation runs on. Rules, branches and terms live in contiguous arrays and refer to
+    each other by 32 bit indices, and every name and syntax string is interned once into a single arena. Nothing in it changes after
+    construction, so one instance can be shared between any number of builders and threads
+
+    The branches of each rule are contiguous. Groups of repetitions are branches too, stored after every rule's branches
+*/
+
+namespace Ir {
+
+    using Index = uint32_t;
+
+    enum Term_type : U8 {
+        TERM_SYNTAX,
+        TERM_RULE,
+        TERM_REPETITION,
+    };
+
+    /// `value` is the index of the rule for rule terms, the index of the string for syntax terms, and the index of the group's
+    /// branch for repetitions. Open ended repetitions, (...)*, (...)+ and (...){m,}, have a `max_repetitions` of 0 and only get their
+    /// upper bound when generating
+    struct Term {
+        Token::Kind kind;
+        Index value;
+        uint32_t min_repetitions;
+        uint32_t max_repetitions;
+        Term_type type;
+        U8 open_ended;
+
+        /// @brief Most repetitions allowed, where open ended repetitions go up to `wildcard_max`
+        inline uint32_t max_repetitions_within(uint32_t wildcard_max) const {
+            return open_ended ? std::max(min_repetitions, wildcard_max) : max_repetitions;
+        }
+    };
+
+    struct Kind_count {
+        Token::Kind kind;
+        uint32_t count;
+    };
+
+    /// `kind_counts` counts the rule kinds outside repetitions, `repeated_kinds` holds the most times each kind can occur inside them.
+    /// Both are sorted by kind. `weight` is only used between the branches of a rule
+    struct Branch {
+        Index first_term;
+        Index n_terms;
+        Index first_kind_count;
+        Index n_kind_counts;
+        Index first_repeated_kind;
+        Index n_repeated_kinds;
+        Index n_repetitions;
+        float weight;
+        U8 recursive;
+    };
+
+    struct Rule {
+        Index name;
+        Token::Kind kind;
+        Index first_branch;
+        Index n_branches;
+        U8 scope;
+        U8 recursive;
+    };
+
+    struct String {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct Tables {
+        std::vector<Rule> rules;
+        std::vector<Branch> branches;
+        std::vector<Term> terms;
+        std::vector<Kind_count> kind_counts;
+        std::vector<Kind_count> repeated_kinds;
+        std::vector<String> strings;
+        std::string arena;
+    };
+
+    class Grammar {
+
+        public:
+            /// @brief Freeze a grammar built from its definition file
+            Grammar(const ::Grammar& grammar);
+
+            /// @brief Adopt tables loaded from elsewhere, i.e the grammar cache. Call `valid` before using them
+            Grammar(const fs::path& filename, Tables _tables);
+
+            /// @brief Check every index in the tables is in range, and that groups only ever point forwards
+            bool valid() const;
+
+            inline const Tables& get_tables() const {return tables;}
+
+            inline const Rule& rule(Index index) const {return tables.rules[index];}
+
+            inline const Branch& branch(Index index) const {return tables.branches[index];}
+
+            inline const Term& term(Index index) const {return tables.terms[index];}
+
+            inline std::string_view string(Index index) const {
+                const String& s = tables.strings[index];
+                return std::string_view(tables.arena).substr(s.offset, s.length);
+            }
+
+            inline std::string_view rule_name(Index index) const {return string(tables.rules[index].name);}
+
+            /// @brief Text a term stands for: the name of a rule, or the syntax itself
+            inline std::string_view term_string(const Term& term) const {
+                return (term.type == TERM_RULE) ? rule_name(term.value) : string(term.value);
+            }
+
+            inline U8 term_scope(const Term& term) const {
+                return (term.type == TERM_RULE) ? tables.rules[term.value].scope : NO_SCOPE;
+            }
+
+            /// @brief First rule called `name` whose scope matches `scope`, as in `scope_matches`
+            std::optional<Index> find_rule(const std::string& name, const U8& scope = NO_SCOPE) const;
+
+            /// @brief First rule called `name` defined with exactly `scope`, as entry rules have to be
+            std::optional<Index> find_exact_rule(const std::string& name, const U8& scope) const;
+
+            unsigned int count_rule_occurances(Index branch, const Token::Kind& kind) const;
+
+            /// @brief Most occurances of rule terms of `kind` that the repetitions in the branch can add. `UNBOUNDED` if an open ended
+            /// repetition can add them
+            unsigned int max_repeated_occurances(Index branch, const Token::Kind& kind) const;
+
+            /*
+                Results of the analysis run once the tables are complete. Depth counts the rules on the longest path from a node to
+                its leaves, size counts every node. `UNBOUNDED` marks rules that can never finish deriving
+            */
+            static constexpr uint32_t UNBOUNDED = UINT32_MAX;
+
+            inline uint32_t rule_min_depth(Index rule) const {return rule_depths[rule];}
+
+            inline uint32_t rule_min_size(Index rule) const {return rule_sizes[rule];}
+
+            inline uint32_t branch_min_depth(Index branch) const {return branch_depths[branch];}
+
+            inline uint32_t branch_min_size(Index branch) const {return branch_sizes[branch];}
+
+            /// @brief Whether picking the branch can still lead to the shallowest derivation of its rule. Always picking such
+            /// branches is guaranteed to finish
+            inline bool is_terminating_branch(Index rule, Index branch) const {
+                return (branch_depths[branch] != UNBOUNDED) && (branch_depths[branch] + 1 == rule_depths[rule]);
+            }
+
+            /// @brief Samples the offset of a branch within its rule by weight in constant time. Empty for rules without branches
+            inline const Alias_table& rule_alias_table(Index rule) const {return rule_aliases[rule];}
+
+            /// @brief Rules that can appear in a derivation starting at `entry`
+            std::vector<bool> reachable_rules(Index entry) const;
+
+            void print_analysis(std::ostream& stream, std::optional<Index> entry) const;
+
+            /// @brief Repetition counts for the branch, picked uniformly within bounds or all at their minimum, in the layout `for_each_term`
+            /// reads. Open ended repetitions go up to `wildcard_max`
+            std::vector<unsigned int> random_repetitions(Index branch, std::mt19937& rng, uint32_t wildcard_max, bool minimal = false) const;
+
+            /// @brief Repetition counts for which the branch contains exactly `count` rule terms of each `kind` in the constraint,
+            /// or nothing if there are none. Open ended repetitions that don't produce any of those kinds go up to `wildcard_max`
+            std::optional<std::vector<unsigned int>> solve_repetitions(Index branch, std::span<const Kind_count> constraint, std::mt19937& rng, 
+                uint32_t wildcard_max) const;
+
+            /// @brief Call `visit` on every term of the branch in order, expanding each repetition by its entry in `counts`. Each count is
+            /// followed by the counts of the repetitions nested in the group, once for every repeat, in the order they are expanded
+            template<typename F>
+            void for_each_term(Index branch, const std::vector<unsigned int>& counts, F&& visit) const {
+                size_t index = 0;
+                for_each_term(branch, counts, index, visit);
+            }
+
+            void print_rules() const;
+
+            void print_tokens() const;
+
+            friend std::ostream& operator<<(std::ostream& stream, const Grammar& grammar);
+
+            inline std::string get_name() const {return name;}
+
+            inline std::string get_path() const {return path.string();}
+
+        private:
+            template<typename F>
+            void for_each_term(Index branch, const std::vector<unsigned int>& counts, size_t& index, F& visit) const {
+                const Branch& b = tables.branches[branch];
+
+                for(Index t = b.first_term; t < b.first_term + b.n_terms; t++){
+                    const Term& term = tables.terms[t];
+
+                    if(term.type == TERM_REPETITION){
+                        unsigned int n = counts[index++];
+
+                        for(unsigned int r = 0; r < n; r++){
+                            for_each_term(term.value, counts, index, visit);
+                        }
+
+                    } else {
+                        visit(term);
+                    }
+                }
+            }
+
+            void print_branch(std::ostream& stream, Index branch) const;
+
+            void index_rules();
+
+            void analyse();
+
+            void build_alias_tables();
+
+            Tables tables;
+
+            /*
+                same lookup as `::Grammar`, every rule is indexed under every lookup scope it matches, first rule wins. Each rule
+                is also indexed under the scope it is defined with, for lookups that want that scope exactly
+            */
+            struct Rule_slots {
+                std::array<std::optional<Index>, ALL_SCOPES + 1> matching;
+                std::array<std::optional<Index>, ALL_SCOPES + 1> exact;
+            };
+
+            std::unordered_map<std::string, Rule_slots> rule_index;
+
+            std::vector<uint32_t> rule_depths, rule_sizes;
+            std::vector<uint32_t> branch_depths, branch_sizes;
+
+            std::vector<Alias_table> rule_aliases;
+
+            std::string name;
+            fs::path path;
+    };
+
+}
+
+#endif
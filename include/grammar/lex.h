@@ -1,7 +1,7 @@
 #ifndef LEX_H
 #define LEX_H
 
-#include <regex>
+#include <string_view>
 #include <stdio.h>
 #include "string.h"
 #include <stdlib.h>
@@ -140,6 +140,8 @@ namespace Token {
         ZERO_OR_MORE,
         ONE_OR_MORE,
         OPTIONAL,
+        RANGE,
+        WEIGHT,
         ARROW,
         INTERNAL,
         EXTERNAL,
@@ -154,11 +156,48 @@ namespace Token {
         GRAMMAR_SYNTAX_BOTTOM,
     };
 
+    /*
+        Every kind by its name, in no particular order. Grammar caches store kinds as numbers, so this is hashed into their key: renumbering
+        the kinds then rebuilds every cache instead of reading the old numbers back as the wrong kinds
+    */
+    constexpr std::pair<std::string_view, Kind> KIND_NAMES[] = {
+        {"_EOF", _EOF}, {"RULE_KINDS_TOP", RULE_KINDS_TOP}, {"RULE", RULE}, {"H", H}, {"X", X}, {"Y", Y}, {"Z", Z}, {"RZ", RZ}, {"RX", RX}, {"RY", RY},
+        {"U1", U1}, {"S", S}, {"SDG", SDG}, {"T", T}, {"TDG", TDG}, {"V", V}, {"VDG", VDG}, {"PHASEDXPOWGATE", PHASEDXPOWGATE},
+        {"PROJECT_Z", PROJECT_Z}, {"MEASURE_AND_RESET", MEASURE_AND_RESET}, {"MEASURE", MEASURE}, {"CX", CX}, {"CY", CY}, {"CZ", CZ},
+        {"CCX", CCX}, {"U2", U2}, {"CNOT", CNOT}, {"CH", CH}, {"CRZ", CRZ}, {"U3", U3}, {"CSWAP", CSWAP}, {"TOFFOLI", TOFFOLI}, {"U", U},
+        {"BARRIER", BARRIER}, {"SUBROUTINE_DEFS", SUBROUTINE_DEFS}, {"BLOCK", BLOCK}, {"BODY", BODY}, {"QUBIT_DEFS", QUBIT_DEFS},
+        {"BIT_DEFS", BIT_DEFS}, {"QUBIT_DEF", QUBIT_DEF}, {"BIT_DEF", BIT_DEF}, {"REGISTER_QUBIT_DEF", REGISTER_QUBIT_DEF},
+        {"SINGULAR_QUBIT_DEF", SINGULAR_QUBIT_DEF}, {"REGISTER_BIT_DEF", REGISTER_BIT_DEF}, {"SINGULAR_BIT_DEF", SINGULAR_BIT_DEF},
+        {"CIRCUIT_NAME", CIRCUIT_NAME}, {"FLOAT_LIST", FLOAT_LIST}, {"FLOAT_LITERAL", FLOAT_LITERAL},
+        {"MAIN_CIRCUIT_NAME", MAIN_CIRCUIT_NAME}, {"QUBIT_DEF_NAME", QUBIT_DEF_NAME}, {"BIT_DEF_NAME", BIT_DEF_NAME}, {"QUBIT", QUBIT},
+        {"BIT", BIT}, {"QUBIT_OP", QUBIT_OP}, {"GATE_OP", GATE_OP}, {"SUBROUTINE_OP", SUBROUTINE_OP}, {"GATE_MAME", GATE_MAME},
+        {"QUBIT_LIST", QUBIT_LIST}, {"BIT_LIST", BIT_LIST}, {"QUBIT_DEF_LIST", QUBIT_DEF_LIST}, {"QUBIT_DEF_SIZE", QUBIT_DEF_SIZE},
+        {"BIT_DEF_LIST", BIT_DEF_LIST}, {"BIT_DEF_SIZE", BIT_DEF_SIZE}, {"SINGULAR_QUBIT", SINGULAR_QUBIT},
+        {"REGISTER_QUBIT", REGISTER_QUBIT}, {"SINGULAR_BIT", SINGULAR_BIT}, {"REGISTER_BIT", REGISTER_BIT}, {"QUBIT_NAME", QUBIT_NAME},
+        {"BIT_NAME", BIT_NAME}, {"QUBIT_INDEX", QUBIT_INDEX}, {"BIT_INDEX", BIT_INDEX}, {"SUBROUTINE", SUBROUTINE},
+        {"CIRCUIT_ID", CIRCUIT_ID}, {"INDENT", INDENT}, {"DEDENT", DEDENT}, {"IF_STMT", IF_STMT}, {"ELSE_STMT", ELSE_STMT},
+        {"ELIF_STMT", ELIF_STMT}, {"DISJUNCTION", DISJUNCTION}, {"CONJUNCTION", CONJUNCTION}, {"INVERSION", INVERSION},
+        {"EXPRESSION", EXPRESSION}, {"COMPARE_OP_BITWISE_OR_PAIR", COMPARE_OP_BITWISE_OR_PAIR}, {"NUMBER", NUMBER},
+        {"SUBROUTINE_OP_ARGS", SUBROUTINE_OP_ARGS}, {"GATE_OP_ARGS", GATE_OP_ARGS}, {"SUBROUTINE_OP_ARG", SUBROUTINE_OP_ARG},
+        {"COMPOUND_STMT", COMPOUND_STMT}, {"COMPOUND_STMTS", COMPOUND_STMTS}, {"REGISTER_RESOURCE", REGISTER_RESOURCE},
+        {"REGISTER_RESOURCE_DEF", REGISTER_RESOURCE_DEF}, {"SINGULAR_RESOURCE", SINGULAR_RESOURCE},
+        {"SINGULAR_RESOURCE_DEF", SINGULAR_RESOURCE_DEF}, {"RESOURCE_DEF", RESOURCE_DEF}, {"RULE_KINDS_BOTTOM", RULE_KINDS_BOTTOM},
+        {"GRAMMAR_SYNTAX_TOP", GRAMMAR_SYNTAX_TOP}, {"SEPARATOR", SEPARATOR}, {"RULE_START", RULE_START}, {"RULE_APPEND", RULE_APPEND},
+        {"RULE_END", RULE_END}, {"SYNTAX", SYNTAX}, {"LPAREN", LPAREN}, {"LBRACK", LBRACK}, {"LBRACE", LBRACE}, {"RPAREN", RPAREN},
+        {"RBRACK", RBRACK}, {"RBRACE", RBRACE}, {"ZERO_OR_MORE", ZERO_OR_MORE}, {"ONE_OR_MORE", ONE_OR_MORE}, {"OPTIONAL", OPTIONAL},
+        {"RANGE", RANGE}, {"WEIGHT", WEIGHT}, {"ARROW", ARROW}, {"INTERNAL", INTERNAL}, {"EXTERNAL", EXTERNAL}, {"OWNED", OWNED},
+        {"COMMENT", COMMENT}, {"MULTI_COMMENT_START", MULTI_COMMENT_START}, {"MULTI_COMMENT_END", MULTI_COMMENT_END},
+        {"GRAMMAR_SYNTAX_BOTTOM", GRAMMAR_SYNTAX_BOTTOM}
+    };
+
+    static_assert(sizeof(KIND_NAMES) / sizeof(KIND_NAMES[0]) == GRAMMAR_SYNTAX_BOTTOM + 1, "Every token kind needs an entry in KIND_NAMES");
+
     inline bool is_wildcard(const Kind& kind) {
         return 
             (kind ==  OPTIONAL) || 
             (kind == ZERO_OR_MORE) || 
-            (kind == ONE_OR_MORE)
+            (kind == ONE_OR_MORE) ||
+            (kind == RANGE)
             ;
     }
 
@@ -195,182 +234,216 @@ namespace Token {
             return stream;
         }
     };
+    
+}
 
-    struct Rule {
+namespace Lexer {
 
-        Rule(const std::string& p, const Kind& k, bool match_exact = true){
-            pattern = p;
-            kind = k;
+    /// @brief Reserved words of the grammar language. Anything that looks like an identifier but isn't in here is a plain `RULE`. 
+    /// Syntax keywords such as NEWLINE carry the string they stand for in `value`
+    struct Keyword {
+        std::string_view name;
+        Token::Kind kind;
+        std::string_view value = "";
+    };
 
-            mod_pattern(match_exact);
-        }
+    constexpr Keyword KEYWORDS[] = {
+
+        {"subroutine_defs", Token::SUBROUTINE_DEFS},
+        {"block", Token::BLOCK},
+        {"body", Token::BODY},
+        {"qubit_defs", Token::QUBIT_DEFS},
+        {"bit_defs", Token::BIT_DEFS},
+        {"qubit_def", Token::QUBIT_DEF},
+        {"bit_def", Token::BIT_DEF},
+        {"register_qubit_def", Token::REGISTER_QUBIT_DEF},
+        {"singular_qubit_def", Token::SINGULAR_QUBIT_DEF},
+        {"register_bit_def", Token::REGISTER_BIT_DEF},
+        {"singular_bit_def", Token::SINGULAR_BIT_DEF},
+        {"circuit_name", Token::CIRCUIT_NAME},
+        {"float_list", Token::FLOAT_LIST},
+        {"float_literal", Token::FLOAT_LITERAL},
+        {"main_circuit_name", Token::MAIN_CIRCUIT_NAME},
+        {"qubit_def_name", Token::QUBIT_DEF_NAME},
+        {"bit_def_name", Token::BIT_DEF_NAME},
+        {"qubit", Token::QUBIT},
+        {"bit", Token::BIT},
+        {"qubit_op", Token::QUBIT_OP},
+        {"gate_op", Token::GATE_OP},
+        {"subroutine_op", Token::SUBROUTINE_OP},
+        {"gate_name", Token::GATE_MAME},
+        {"qubit_list", Token::QUBIT_LIST},
+        {"bit_list", Token::BIT_LIST},
+        {"qubit_def_list", Token::QUBIT_DEF_LIST},
+        {"qubit_def_size", Token::QUBIT_DEF_SIZE},
+        {"bit_def_list", Token::BIT_DEF_LIST},
+        {"bit_def_size", Token::BIT_DEF_SIZE},
+        {"singular_qubit", Token::SINGULAR_QUBIT},
+        {"register_qubit", Token::REGISTER_QUBIT},
+        {"singular_bit", Token::SINGULAR_BIT},
+        {"register_bit", Token::REGISTER_BIT},
+        {"qubit_name", Token::QUBIT_NAME},
+        {"bit_name", Token::BIT_NAME},
+        {"qubit_index", Token::QUBIT_INDEX},
+        {"bit_index", Token::BIT_INDEX},
+        {"subroutine", Token::SUBROUTINE},
+        {"circuit_id", Token::CIRCUIT_ID},
+        {"INDENT", Token::INDENT},
+        {"DEDENT", Token::DEDENT},
+        {"if_stmt", Token::IF_STMT},
+        {"else_stmt", Token::ELSE_STMT},
+        {"elif_stmt", Token::ELIF_STMT},
+        {"disjunction", Token::DISJUNCTION},
+        {"conjunction", Token::CONJUNCTION},
+        {"inversion", Token::INVERSION},
+        {"expression", Token::EXPRESSION},
+        {"compare_op_bitwise_or_pair", Token::COMPARE_OP_BITWISE_OR_PAIR},
+        {"NUMBER", Token::NUMBER},
+        {"subroutine_op_args", Token::SUBROUTINE_OP_ARGS},
+        {"gate_op_args", Token::GATE_OP_ARGS},
+        {"subroutine_op_arg", Token::SUBROUTINE_OP_ARG},
+        {"compound_stmt", Token::COMPOUND_STMT},
+        {"compound_stmts", Token::COMPOUND_STMTS},
+
+        {"h", Token::H},
+        {"x", Token::X},
+        {"y", Token::Y},
+        {"z", Token::Z},
+        {"rz", Token::RZ},
+        {"rx", Token::RX},
+        {"ry", Token::RY},
+        {"u1", Token::U1},
+        {"s", Token::S},
+        {"sdg", Token::SDG},
+        {"t", Token::T},
+        {"tdg", Token::TDG},
+        {"v", Token::V},
+        {"vdg", Token::VDG},
+        {"phasedxpowgate", Token::PHASEDXPOWGATE},
+        {"project_z", Token::PROJECT_Z},
+        {"measure_and_reset", Token::MEASURE_AND_RESET},
+        {"measure", Token::MEASURE},
+        {"cx", Token::CX},
+        {"cy", Token::CY},
+        {"cz", Token::CZ},
+        {"ccx", Token::CCX},
+        {"u2", Token::U2},
+        {"cnot", Token::CNOT},
+        {"ch", Token::CH},
+        {"crz", Token::CRZ},
+        {"u3", Token::U3},
+        {"cswap", Token::CSWAP},
+        {"toffoli", Token::TOFFOLI},
+        {"u", Token::U},
+        {"barrier", Token::BARRIER},
+
+        {"LPAREN", Token::SYNTAX, "("},
+        {"RPAREN", Token::SYNTAX, ")"},
+        {"LBRACK", Token::SYNTAX, "["},
+        {"RBRACK", Token::SYNTAX, "]"},
+        {"LBRACE", Token::SYNTAX, "{"},
+        {"RBRACE", Token::SYNTAX, "}"},
+        {"COMMA", Token::SYNTAX, ","},
+        {"SPACE", Token::SYNTAX, " "},
+        {"DOT", Token::SYNTAX, "."},
+        {"SINGLE_QUOTE", Token::SYNTAX, "\'"},
+        {"DOUBLE_QUOTE", Token::SYNTAX, "\""},
+        {"EQUALS", Token::SYNTAX, "="},
+        {"NEWLINE", Token::SYNTAX, "\n"},
+
+        {"EXTERNAL", Token::EXTERNAL},
+        {"INTERNAL", Token::INTERNAL},
+        {"OWNED", Token::OWNED},
+    };
 
-        Rule(const std::string& p, const Kind& k, std::optional<std::string> v, bool match_exact = true){
-            pattern = p;
-            kind = k;
-            value = v;
+    constexpr size_t NUM_KEYWORDS = sizeof(KEYWORDS) / sizeof(Keyword);
 
-            mod_pattern(match_exact);
+    /*
+        Keywords are looked up through a perfect hash table: the salt is searched for at compile time such that every keyword lands
+        in its own slot, so a lookup is one hash, one load and one string compare
+    */
+    constexpr size_t KEYWORD_TABLE_SIZE = 2048;
+
+    static_assert((KEYWORD_TABLE_SIZE & (KEYWORD_TABLE_SIZE - 1)) == 0, "Keyword table size must be a power of 2");
+    static_assert(NUM_KEYWORDS < 255, "Keyword table slots are stored as U8");
+
+    constexpr U64 keyword_hash(std::string_view word, U64 salt){
+        U64 hash = 14695981039346656037ULL ^ (salt * 0x9E3779B97F4A7C15ULL);
+
+        for(const char& c : word){
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 1099511628211ULL;
         }
 
-        void mod_pattern(const bool& match_exact){
-        
-            if(match_exact){
-                pattern = "^" + pattern + "$";
+        return hash ^ (hash >> 29);
+    }
+
+    constexpr U64 KEYWORD_SALT = []{
+        for(U64 salt = 0; salt < 4096; salt++){
+            std::array<bool, KEYWORD_TABLE_SIZE> taken = {};
+            bool collision = false;
+
+            for(size_t i = 0; (i < NUM_KEYWORDS) && !collision; i++){
+                size_t slot = keyword_hash(KEYWORDS[i].name, salt) & (KEYWORD_TABLE_SIZE - 1);
+                collision = taken[slot];
+                taken[slot] = true;
             }
+
+            if(!collision) return salt;
         }
 
-        std::string pattern;
-        Kind kind;
+        throw "No collision free salt found for keyword table, increase KEYWORD_TABLE_SIZE";
+    }();
 
-        std::optional<std::string> value = std::nullopt;
-    };
-    
-}
+    /// each slot holds index + 1 of the keyword that hashes to it, 0 for empty slots
+    constexpr std::array<U8, KEYWORD_TABLE_SIZE> KEYWORD_TABLE = []{
+        std::array<U8, KEYWORD_TABLE_SIZE> table = {};
 
-namespace Lexer {
+        for(size_t i = 0; i < NUM_KEYWORDS; i++){
+            table[keyword_hash(KEYWORDS[i].name, KEYWORD_SALT) & (KEYWORD_TABLE_SIZE - 1)] = i + 1;
+        }
+
+        return table;
+    }();
+
+    inline const Keyword* find_keyword(std::string_view word){
+        U8 slot = KEYWORD_TABLE[keyword_hash(word, KEYWORD_SALT) & (KEYWORD_TABLE_SIZE - 1)];
 
-    const std::vector<Token::Rule> TOKEN_RULES = {
-
-        Token::Rule(R"(subroutine_defs)", Token::SUBROUTINE_DEFS),
-        Token::Rule(R"(block)", Token::BLOCK),
-        Token::Rule(R"(body)", Token::BODY),
-        Token::Rule(R"(qubit_defs)", Token::QUBIT_DEFS),
-        Token::Rule(R"(bit_defs)", Token::BIT_DEFS),
-        Token::Rule(R"(qubit_def)", Token::QUBIT_DEF),
-        Token::Rule(R"(bit_def)", Token::BIT_DEF),
-        Token::Rule(R"(register_qubit_def)", Token::REGISTER_QUBIT_DEF),
-        Token::Rule(R"(singular_qubit_def)", Token::SINGULAR_QUBIT_DEF),
-        Token::Rule(R"(register_bit_def)", Token::REGISTER_BIT_DEF),
-        Token::Rule(R"(singular_bit_def)", Token::SINGULAR_BIT_DEF),
-        Token::Rule(R"(circuit_name)", Token::CIRCUIT_NAME),
-        Token::Rule(R"(float_list)", Token::FLOAT_LIST),
-        Token::Rule(R"(float_literal)", Token::FLOAT_LITERAL),
-        Token::Rule(R"(main_circuit_name)", Token::MAIN_CIRCUIT_NAME),
-        Token::Rule(R"(qubit_def_name)", Token::QUBIT_DEF_NAME),
-        Token::Rule(R"(bit_def_name)", Token::BIT_DEF_NAME),
-        Token::Rule(R"(qubit)", Token::QUBIT),
-        Token::Rule(R"(bit)", Token::BIT),
-        Token::Rule(R"(qubit_op)", Token::QUBIT_OP),
-        Token::Rule(R"(gate_op)", Token::GATE_OP),
-        Token::Rule(R"(subroutine_op)", Token::SUBROUTINE_OP),
-        Token::Rule(R"(gate_name)", Token::GATE_MAME),
-        Token::Rule(R"(qubit_list)", Token::QUBIT_LIST),
-        Token::Rule(R"(bit_list)", Token::BIT_LIST),
-        Token::Rule(R"(qubit_def_list)", Token::QUBIT_DEF_LIST),
-        Token::Rule(R"(qubit_def_size)", Token::QUBIT_DEF_SIZE),
-        Token::Rule(R"(bit_def_list)", Token::BIT_DEF_LIST),
-        Token::Rule(R"(bit_def_size)", Token::BIT_DEF_SIZE),
-        Token::Rule(R"(singular_qubit)", Token::SINGULAR_QUBIT),
-        Token::Rule(R"(register_qubit)", Token::REGISTER_QUBIT),
-        Token::Rule(R"(singular_bit)", Token::SINGULAR_BIT),
-        Token::Rule(R"(register_bit)", Token::REGISTER_BIT),
-        Token::Rule(R"(qubit_name)", Token::QUBIT_NAME),
-        Token::Rule(R"(bit_name)", Token::BIT_NAME),
-        Token::Rule(R"(qubit_index)", Token::QUBIT_INDEX),
-        Token::Rule(R"(bit_index)", Token::BIT_INDEX),
-        Token::Rule(R"(subroutine)", Token::SUBROUTINE),
-        Token::Rule(R"(circuit_id)", Token::CIRCUIT_ID),
-        Token::Rule(R"(INDENT)", Token::INDENT),
-        Token::Rule(R"(DEDENT)", Token::DEDENT),
-        Token::Rule(R"(if_stmt)", Token::IF_STMT),
-        Token::Rule(R"(else_stmt)", Token::ELSE_STMT),
-        Token::Rule(R"(elif_stmt)", Token::ELIF_STMT),
-        Token::Rule(R"(disjunction)", Token::DISJUNCTION),
-        Token::Rule(R"(conjunction)", Token::CONJUNCTION),
-        Token::Rule(R"(inversion)", Token::INVERSION),
-        Token::Rule(R"(expression)", Token::EXPRESSION),
-        Token::Rule(R"(compare_op_bitwise_or_pair)", Token::COMPARE_OP_BITWISE_OR_PAIR),
-        Token::Rule(R"(NUMBER)", Token::NUMBER),
-        Token::Rule(R"(subroutine_op_args)", Token::SUBROUTINE_OP_ARGS),
-        Token::Rule(R"(gate_op_args)", Token::GATE_OP_ARGS),
-        Token::Rule(R"(subroutine_op_arg)", Token::SUBROUTINE_OP_ARG),
-        Token::Rule(R"(compound_stmt)", Token::COMPOUND_STMT),
-        Token::Rule(R"(compound_stmts)", Token::COMPOUND_STMTS),
-
-        Token::Rule(R"(h)", Token::H),
-        Token::Rule(R"(x)", Token::X),
-        Token::Rule(R"(y)", Token::Y),
-        Token::Rule(R"(z)", Token::Z),
-        Token::Rule(R"(rz)", Token::RZ),
-        Token::Rule(R"(rx)", Token::RX),
-        Token::Rule(R"(ry)", Token::RY),
-        Token::Rule(R"(u1)", Token::U1),
-        Token::Rule(R"(s)", Token::S),
-        Token::Rule(R"(sdg)", Token::SDG),
-        Token::Rule(R"(t)", Token::T),
-        Token::Rule(R"(tdg)", Token::TDG),
-        Token::Rule(R"(v)", Token::V),
-        Token::Rule(R"(vdg)", Token::VDG),
-        Token::Rule(R"(phasedxpowgate)", Token::PHASEDXPOWGATE),
-        Token::Rule(R"(project_z)", Token::PROJECT_Z),
-        Token::Rule(R"(measure_and_reset)", Token::MEASURE_AND_RESET),
-        Token::Rule(R"(measure)", Token::MEASURE),
-        Token::Rule(R"(cx)", Token::CX),
-        Token::Rule(R"(cy)", Token::CY),
-        Token::Rule(R"(cz)", Token::CZ),
-        Token::Rule(R"(ccx)", Token::CCX),
-        Token::Rule(R"(u2)", Token::U2),
-        Token::Rule(R"(cnot)", Token::CNOT),
-        Token::Rule(R"(ch)", Token::CH),
-        Token::Rule(R"(crz)", Token::CRZ),
-        Token::Rule(R"(u3)", Token::U3),
-        Token::Rule(R"(cswap)", Token::CSWAP),
-        Token::Rule(R"(toffoli)", Token::TOFFOLI),
-        Token::Rule(R"(u)", Token::U),
-        Token::Rule(R"(barrier)", Token::BARRIER),
-
-        Token::Rule(R"(LPAREN)", Token::SYNTAX, std::make_optional<std::string>("(")),
-        Token::Rule(R"(RPAREN)", Token::SYNTAX, std::make_optional<std::string>(")")),
-        Token::Rule(R"(LBRACK)", Token::SYNTAX, std::make_optional<std::string>("[")),
-        Token::Rule(R"(RBRACK)", Token::SYNTAX, std::make_optional<std::string>("]")),
-        Token::Rule(R"(LBRACE)", Token::SYNTAX, std::make_optional<std::string>("{")),
-        Token::Rule(R"(RBRACE)", Token::SYNTAX, std::make_optional<std::string>("}")),
-        Token::Rule(R"(COMMA)", Token::SYNTAX, std::make_optional<std::string>(",")),
-        Token::Rule(R"(SPACE)", Token::SYNTAX, std::make_optional<std::string>(" ")),
-        Token::Rule(R"(DOT)", Token::SYNTAX, std::make_optional<std::string>(".")),
-        Token::Rule(R"(SINGLE_QUOTE)", Token::SYNTAX, std::make_optional<std::string>("\'")),
-        Token::Rule(R"(DOUBLE_QUOTE)", Token::SYNTAX, std::make_optional<std::string>("\"")),
-        Token::Rule(R"(EQUALS)", Token::SYNTAX, std::make_optional<std::string>("=")),
-        Token::Rule(R"(NEWLINE)", Token::SYNTAX, std::make_optional<std::string>("\n")),
-        Token::Rule(R"(\".*?\"|\'.*?\')", Token::SYNTAX, false),
-
-        Token::Rule(R"(EXTERNAL(::)?)", Token::EXTERNAL, false),
-        Token::Rule(R"(INTERNAL(::)?)", Token::INTERNAL, false),
-        Token::Rule(R"(OWNED(::)?)", Token::OWNED, false),
-
-        Token::Rule(R"([a-zA-Z_]+)", Token::RULE, false),
-
-        Token::Rule(R"(\(\*)", Token::MULTI_COMMENT_START, false),
-        Token::Rule(R"(\*\))", Token::MULTI_COMMENT_END, false),
-        Token::Rule(R"(=|:)", Token::RULE_START, false),
-        Token::Rule(R"(\+=)", Token::RULE_APPEND, false),
-        Token::Rule(R"(\|)", Token::SEPARATOR, false),
-        Token::Rule(R"(;)", Token::RULE_END, false),
-        Token::Rule(R"(\()", Token::LPAREN, false),
-        Token::Rule(R"(\))", Token::RPAREN, false),
-        Token::Rule(R"(\[)", Token::LBRACK, false),
-        Token::Rule(R"(\])", Token::RBRACK, false),
-        Token::Rule(R"(\{)", Token::LBRACE, false),
-        Token::Rule(R"(\})", Token::RBRACE, false),
-        Token::Rule(R"(\*)", Token::ZERO_OR_MORE, false),
-        Token::Rule(R"(\?)", Token::OPTIONAL, false),
-        Token::Rule(R"(\+)", Token::ONE_OR_MORE, false),
-        Token::Rule(R"(\-\>)", Token::ARROW, false),
-        Token::Rule(R"(#)", Token::COMMENT, false),
+        if(slot && (KEYWORDS[slot - 1].name == word)){
+            return &KEYWORDS[slot - 1];
+        }
+
+        return nullptr;
+    }
+
+    /*
+        Character classes that drive the scanner's state transitions
+    */
+    enum Char_class : U8 {
+        CC_OTHER,
+        CC_SPACE,
+        CC_NEWLINE,
+        CC_IDENT_START,
+        CC_DIGIT,
+        CC_QUOTE,
+        CC_PUNCT,
     };
 
-    const std::string FULL_REGEX = [] {
-        std::string regex = "(";
+    constexpr std::array<Char_class, 256> CHAR_CLASSES = []{
+        std::array<Char_class, 256> classes = {};
 
-        for (size_t i = 0; i < TOKEN_RULES.size(); i++) {
-            regex += TOKEN_RULES[i].pattern;
+        for(int c = 'a'; c <= 'z'; c++) classes[c] = CC_IDENT_START;
+        for(int c = 'A'; c <= 'Z'; c++) classes[c] = CC_IDENT_START;
+        for(int c = '0'; c <= '9'; c++) classes[c] = CC_DIGIT;
 
-            if (i + 1 < TOKEN_RULES.size()) regex += "|";
-        }
-        regex += ")";
+        classes['_'] = CC_IDENT_START;
+        classes[' '] = classes['\t'] = classes['\r'] = classes['\v'] = classes['\f'] = CC_SPACE;
+        classes['\n'] = CC_NEWLINE;
+        classes['"'] = classes['\''] = CC_QUOTE;
+
+        for(const char& c : std::string_view("()[]{}=:+|;*?#-@")) classes[(U8)c] = CC_PUNCT;
 
-        return regex;
+        return classes;
     }();
             
     class Lexer{
@@ -394,11 +467,6 @@ namespace Lexer {
                 return token;      
             }
 
-            inline bool string_is(const std::string& string, const std::string& pattern){
-                bool matches = std::regex_match(string, std::regex(pattern));
-                return ((ignore == false) && matches) || (string == "*)") ;
-            }
-
             void lex();
 
             void print_tokens() const;
@@ -411,7 +479,6 @@ namespace Lexer {
         private:
             Result<std::vector<Token::Token>> result;
             std::string _filename = "bnf.bnf"; 
-            bool ignore = false;
             
     };
 }
@@ -3,8 +3,6 @@
 
 #include <branch.h>
 
-class Node;
-
 class Rule {
 
     public:
@@ -29,7 +27,7 @@ class Rule {
 
         bool get_recursive_flag() const {return recursive;}
                 
-        std::vector<Branch> get_branches(){return branches;}
+        const std::vector<Branch>& get_branches() const {return branches;}
 
         void add(const Branch& b);
 
@@ -39,8 +37,6 @@ class Rule {
 
         inline void clear(){branches.clear();}
 
-        Branch pick_branch(std::shared_ptr<Node> parent);
-
         bool operator==(const Rule& other) const {
             return (token == other.get_token()) && scope_matches(scope, other.get_scope());
         }
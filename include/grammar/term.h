@@ -5,14 +5,21 @@
 #include <lex.h>
 
 class Rule;
+class Branch;
 
 class Term {
     public:
         Term(){}
 
-        Term(const std::shared_ptr<Rule> rule, const Token::Kind& _kind, unsigned int _branch_nesting_depth = 0);
+        Term(const std::shared_ptr<Rule> rule, const Token::Kind& _kind);
 
-        Term(const std::string& syntax, const Token::Kind& _kind, unsigned int _branch_nesting_depth = 0);
+        Term(const std::string& syntax, const Token::Kind& _kind);
+
+        /// @brief Repetition of a group of terms, written as (...)*, (...)+, (...)? or (...){m,n}. The number of repetitions is only
+        /// chosen when a branch containing it is picked during generation. Open ended repetitions have no `_max_repetitions`, 
+        /// the limits generated under decide their upper bound
+        Term(const std::shared_ptr<const Branch> group, const Token::Kind& _kind, unsigned int _min_repetitions, 
+            std::optional<unsigned int> _max_repetitions);
         
         ~Term() = default;
 
@@ -20,6 +27,8 @@ class Term {
 
         std::string get_syntax() const;
 
+        std::shared_ptr<const Branch> get_group() const;
+
         std::string get_string() const;
 
         U8 get_scope() const;
@@ -28,19 +37,26 @@ class Term {
 
         bool is_rule() const;
 
+        bool is_repetition() const;
+
         friend std::ostream& operator<<(std::ostream& stream, Term term);
 
         bool operator==(const Term& other) const;
 
         Token::Kind get_kind() const {return kind;} 
 
-        unsigned int get_branch_nesting_depth() const { return branch_nesting_depth; }
+        unsigned int get_min_repetitions() const {return min_repetitions;}
+
+        std::optional<unsigned int> get_max_repetitions() const {return max_repetitions;}
+
+        bool is_open_ended() const {return !max_repetitions.has_value();}
 
     private:
-        std::variant<std::shared_ptr<Rule>, std::string> value;
+        std::variant<std::shared_ptr<Rule>, std::string, std::shared_ptr<const Branch>> value;
         Token::Kind kind;
 
-        unsigned int branch_nesting_depth = 0;
+        unsigned int min_repetitions = 1;
+        std::optional<unsigned int> max_repetitions = 1;
 };
 
 #endif
@@ -0,0 +1,47 @@
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include <genome.h>
+
+/*
+    what a successful build hands back: the root of the program's tree and the DAG of its main circuit, both owned by the program
+    alone. It can only be moved, so neither the tree nor the DAG is ever copied on the way out of the builder
+*/
+class Program {
+
+    public:
+        /// @brief Empty program, only there so that a result can start out without one
+        Program(){}
+
+        /// @brief `_nodes` is the table the tree under `_root` was built in
+        Program(std::shared_ptr<Node> _root, std::shared_ptr<const Node_table> _nodes, Dag::Dag&& _dag):
+            root(std::move(_root)),
+            nodes(std::move(_nodes)),
+            dag(std::move(_dag))
+        {}
+
+        Program(const Program&) = delete;
+        Program& operator=(const Program&) = delete;
+
+        Program(Program&&) = default;
+        Program& operator=(Program&&) = default;
+
+        inline const Node& get_root() const {return *root;}
+
+        inline const Dag::Dag& get_dag() const {return dag;}
+
+        inline void render_dag(const fs::path& current_circuit_dir, bool verbose){dag.render_dag(current_circuit_dir, verbose);}
+
+        /// @brief Hand the DAG over to a genome, which leaves the program without one
+        inline Genome take_genome(){
+            int score = dag.score();
+            return Genome{.dag = std::move(dag), .dag_score = score};
+        }
+
+    private:
+        std::shared_ptr<Node> root;
+        std::shared_ptr<const Node_table> nodes;
+        Dag::Dag dag;
+};
+
+#endif
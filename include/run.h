@@ -4,24 +4,47 @@
 #include <sstream>
 #include <set>
 #include <iomanip>
+#include <mutex>
+#include <thread>
+#include <atomic>
 
 #include <generator.h>
+#include <grammar.h>
 
 class Run{
 
     public:
-        Run(const std::string& _grammars_dir);
+        /// @brief Find every grammar in the directory. Unless `_lazy` is set, they are all built straight away over a pool of threads,
+        /// otherwise each one is built the first time it is named. Programs are generated `n_threads` at a time, 0 for one per core,
+        /// and follow from `seed`, or from a random one. Every grammar starts with `_limits`, which its own `.limits` file can override
+        Run(const std::string& _grammars_dir, bool _lazy = false, unsigned int n_threads = 0, std::optional<U64> seed = std::nullopt, 
+            const Common::Limits& _limits = Common::Limits());
+
+        ~Run();
 
         inline bool is_grammar(const std::string& name){
-            return generators.find(name) != generators.end();
+            std::lock_guard<std::mutex> lock(grammars_mutex);
+            return grammar_files.find(name) != grammar_files.end();
         }
 
+        std::shared_ptr<Generator> get_generator(const std::string& name);
+
         void help();
 
         void run_tests();
 
         void set_grammar();
 
+        /// @brief Build the program generated from `seed` by the grammar again, into the replay directory
+        void replay(const std::string& grammar_name, U64 seed, int circuit_number);
+
+        /// @brief Rebuild the grammars whose definitions or limits files, or the meta grammar, changed since they were loaded, and swap in 
+        /// new generators for them, which keep the weights set on the old ones. Anything still holding an old generator keeps using its grammar
+        void reload_grammars();
+
+        /// @brief Start or stop reloading grammars whenever a grammar or limits file in the grammars directory is written
+        void toggle_watch();
+
         void tokenise(const std::string& command, const char& delim);
 
         void remove_all_in_dir(const fs::path& dir);
@@ -31,9 +54,70 @@ class Run{
         void loop();
 
     private:
+        void find_grammar_files();
+
+        /// @brief Limits of a grammar sit next to its definition, e.g pytket.limits for pytket.qf
+        inline static fs::path limits_path(const fs::path& grammar_file){
+            return fs::path(grammar_file).replace_extension(".limits");
+        }
+
+        /// @brief Frozen grammar for the file, from the cache, or built and then cached. `status` says which
+        std::shared_ptr<const Ir::Grammar> load_grammar(const fs::path& file, U64 key, std::string& status);
+
+        /// @brief Load the named grammars over a pool of threads and swap in a generator for each one that loads
+        void build_grammars(const std::vector<std::string>& names);
+
+        /// @brief Pick up the generator of the current grammar if it was reloaded since the last command
+        void refresh_current_generator();
+
+        void watch_grammars();
+
         fs::path grammars_dir;
+        fs::path cache_dir;
+        bool lazy;
+
+        Common::Flags flags;
+
+        /*
+            limits every grammar starts with, before its `.limits` file is read
+        */
+        Common::Limits limits;
+
+        /*
+            every program generated is seeded from the master seed and its number among all the programs generated in this run
+        */
+        U64 master_seed;
+        U64 n_generated = 0;
+
+        fs::path meta_grammar_path;
+        U64 meta_grammar_hash = 0;
+
+        /*
+            base every other grammar is layered over. Only built if some grammar isn't cached, and again whenever the
+            meta grammar changes. Shared read only by every build thread once built
+        */
+        std::shared_ptr<const Grammar> meta_grammar = nullptr;
+        std::optional<U64> built_meta_grammar_hash;
+        std::mutex meta_grammar_mutex;
+
+        /*
+            guards the grammar files, the generators and the keys and limits they were loaded with, which the watcher thread updates
+        */
+        std::mutex grammars_mutex;
+        std::map<std::string, fs::path> grammar_files;
         std::unordered_map<std::string, std::shared_ptr<Generator>> generators;
+        std::unordered_map<std::string, U64> grammar_keys;
+        std::unordered_map<std::string, U64> limits_hashes;
+
+        /*
+            only touched by the REPL, so a generation in progress keeps the generator it started with
+        */
         std::shared_ptr<Generator> current_generator = nullptr;
+        std::string current_grammar_name, current_entry_name;
+        U8 current_scope = NO_SCOPE;
+
+        std::thread watcher;
+        std::atomic<bool> watching = false;
 
         std::vector<std::string> tokens;
 
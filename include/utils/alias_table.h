@@ -0,0 +1,88 @@
+#ifndef ALIAS_TABLE_H
+#define ALIAS_TABLE_H
+
+#include <utils.h>
+
+/*
+    Walker's alias method: after linear setup, picks index i with probability weights[i] / sum(weights) from a single random draw,
+    which splits into a column and a coin flip between the column and its alias. Weights that are all zero pick uniformly
+*/
+class Alias_table {
+
+    public:
+        Alias_table(){}
+
+        Alias_table(const std::vector<float>& weights) :
+            probability(weights.size(), 1.0f),
+            alias(weights.size())
+        {
+            size_t n = weights.size();
+            double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+
+            std::iota(alias.begin(), alias.end(), 0);
+
+            if(total <= 0.0) return;
+
+            // scale so that the average column holds exactly 1
+            std::vector<double> scaled(n);
+            std::vector<uint32_t> small, large;
+
+            for(size_t i = 0; i < n; i++){
+                scaled[i] = weights[i] * n / total;
+                (scaled[i] < 1.0 ? small : large).push_back(i);
+            }
+
+            while(small.size() && large.size()){
+                uint32_t s = small.back(), l = large.back();
+                small.pop_back();
+
+                probability[s] = (weights[s] > 0.0f) ? scaled[s] : 0.0f;
+                alias[s] = l;
+
+                // the large column gives up what the small one was missing
+                scaled[l] -= 1.0 - scaled[s];
+
+                if(scaled[l] < 1.0){
+                    large.pop_back();
+                    small.push_back(l);
+                }
+            }
+
+            /*
+                whatever is left is 1 up to rounding, except columns of weight 0, which rounding mustn't let be picked. Those always
+                give way to the heaviest column
+            */
+            uint32_t heaviest = std::max_element(weights.begin(), weights.end()) - weights.begin();
+
+            for(uint32_t i : small){
+                if(weights[i] > 0.0f){
+                    probability[i] = 1.0f;
+                } else {
+                    probability[i] = 0.0f;
+                    alias[i] = heaviest;
+                }
+            }
+
+            for(uint32_t i : large) probability[i] = 1.0f;
+        }
+
+        inline size_t size() const {return probability.size();}
+
+        inline bool empty() const {return probability.empty();}
+
+        /// @brief Weighted random index. Must not be called on an empty table
+        inline size_t sample(std::mt19937& rng) const {
+            std::uniform_real_distribution<double> dist(0.0, (double)probability.size());
+
+            double x = dist(rng);
+            size_t column = std::min((size_t)x, probability.size() - 1);
+
+            return ((x - column) < probability[column]) ? column : alias[column];
+        }
+
+    private:
+        std::vector<float> probability;
+        std::vector<uint32_t> alias;
+};
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef COLLECTION_H
 #define COLLECTION_H
 
+#include <span>
+
 namespace Resource {
     class Qubit;
     class Bit;
@@ -16,6 +18,11 @@ concept Allowed_Type =
     std::is_same_v<T, Qubit_definition> || 
     std::is_same_v<T, Bit_definition>;
 
+/*
+    Resources or definitions of a block, in the order they were added. Indices of the elements are also kept apart by each element's
+    scope, and the number of elements matching every possible scope is counted as they are added, so nothing that asks about scopes
+    has to walk the elements or allocate
+*/
 template<Allowed_Type T>
 struct Collection {
 
@@ -24,7 +31,19 @@ struct Collection {
         Collection(){}
 
         void add(const T& elem){
-            coll.push_back(std::make_shared<T>(elem));
+            add(std::make_shared<T>(elem));
+        }
+
+        /// @brief Add an element without copying it, i.e one that is also in another collection
+        void add(std::shared_ptr<T> elem){
+            U8 scope = elem->get_scope() & ALL_SCOPES;
+
+            for(U8 s = 0; s <= ALL_SCOPES; s++){
+                if(scope & s) counts[s] += 1;
+            }
+
+            partitions[scope].push_back(coll.size());
+            coll.push_back(std::move(elem));
         }
 
         std::shared_ptr<T> at(size_t index) {
@@ -41,22 +60,18 @@ struct Collection {
             return coll.size();
         }
 
-        size_t get_num_of(const U8& scope) const {
-            size_t sum = 0;
-
-            for(const auto& elem : coll){
-                if (elem->get_scope() & scope) sum += 1;
-            }
+        /// @brief Number of elements sharing a scope flag with `scope`
+        inline size_t get_num_of(const U8& scope) const {
+            return counts[scope & ALL_SCOPES];
+        }
 
-            return sum;
+        inline std::span<const std::shared_ptr<T>> view() const {
+            return coll;
         }
 
-        void reset(){
-            if constexpr (std::is_same_v<T, Resource::Qubit> || std::is_same_v<T, Resource::Bit>){
-                for(auto& elem : coll){
-                    elem->reset();
-                }
-            }
+        /// @brief Indices of the elements whose scope is exactly `scope`, in order
+        inline std::span<const uint32_t> indices_with_scope(const U8& scope) const {
+            return partitions[scope & ALL_SCOPES];
         }
 
         std::vector<std::shared_ptr<T>>::iterator begin(){
@@ -77,6 +92,9 @@ struct Collection {
 
     private:
         std::vector<std::shared_ptr<T>> coll = {};
+
+        std::array<std::vector<uint32_t>, ALL_SCOPES + 1> partitions = {};
+        std::array<size_t, ALL_SCOPES + 1> counts = {};
 };
 
 
@@ -0,0 +1,120 @@
+#ifndef FREE_LIST_H
+#define FREE_LIST_H
+
+#include <utils.h>
+
+/*
+    Indices of the resources of a block that haven't been drawn since the last reset, kept apart by the resource's scope, so that
+    an unused one in any scope is drawn in constant time. Each scope's indices are a partial Fisher-Yates shuffle: the first `n_drawn`
+    have been drawn, the rest are free, in no particular order. Resetting only has to zero the counts. Where each index sits is 
+    tracked too, so a particular one can also be drawn in constant time
+*/
+class Free_list {
+
+    public:
+        Free_list(){}
+
+        /// @brief Start again over the elements of a collection, none of them drawn
+        template<typename C>
+        void assign(const C& collection){
+            positions.resize(collection.size());
+
+            for(U8 s = 0; s <= ALL_SCOPES; s++){
+                std::span<const uint32_t> indices = collection.indices_with_scope(s);
+
+                pools[s].indices.assign(indices.begin(), indices.end());
+                pools[s].n_drawn = 0;
+
+                for(uint32_t i = 0; i < indices.size(); i++){
+                    positions[indices[i]] = Position{.pool = s, .offset = i};
+                }
+            }
+        }
+
+        inline void reset(){
+            for(Pool& pool : pools) pool.n_drawn = 0;
+        }
+
+        /// @brief Number of resources in scope, drawn or not
+        inline size_t count(const U8& scope) const {
+            size_t n = 0;
+
+            for(U8 s = 0; s <= ALL_SCOPES; s++){
+                if(scope_matches(s, scope)) n += pools[s].indices.size();
+            }
+
+            return n;
+        }
+
+        /// @brief Index of a resource in scope picked uniformly from those not drawn yet, which is then drawn. Nothing if there are none
+        inline std::optional<uint32_t> draw(std::mt19937& rng, const U8& scope){
+            size_t n_free = 0;
+
+            for(U8 s = 0; s <= ALL_SCOPES; s++){
+                if(scope_matches(s, scope)) n_free += pools[s].free();
+            }
+
+            if(n_free == 0) return std::nullopt;
+
+            size_t r = random_int(rng, n_free - 1);
+
+            for(U8 s = 0; s <= ALL_SCOPES; s++){
+                Pool& pool = pools[s];
+
+                if(!scope_matches(s, scope)) continue;
+
+                if(r < pool.free()){
+                    swap(pool, pool.n_drawn, pool.n_drawn + r);
+                    return pool.indices[pool.n_drawn++];
+                }
+
+                r -= pool.free();
+            }
+
+            // only reachable if the counts above are wrong
+            return std::nullopt;
+        }
+
+        /// @brief Draw the resource at `index`. False if it was already drawn, or isn't one of the resources
+        inline bool take(uint32_t index){
+            if(index >= positions.size()) return false;
+
+            Pool& pool = pools[positions[index].pool];
+            uint32_t offset = positions[index].offset;
+
+            if(offset < pool.n_drawn) return false;
+
+            swap(pool, pool.n_drawn, offset);
+            pool.n_drawn++;
+
+            return true;
+        }
+
+    private:
+        struct Pool {
+            std::vector<uint32_t> indices;
+            size_t n_drawn = 0;
+
+            inline size_t free() const {return indices.size() - n_drawn;}
+        };
+
+        struct Position {
+            U8 pool;
+            uint32_t offset;
+        };
+
+        inline void swap(Pool& pool, size_t a, size_t b){
+            std::swap(pool.indices[a], pool.indices[b]);
+            positions[pool.indices[a]].offset = a;
+            positions[pool.indices[b]].offset = b;
+        }
+
+        std::array<Pool, ALL_SCOPES + 1> pools;
+
+        /*
+            pool and offset into it of every index
+        */
+        std::vector<Position> positions;
+};
+
+#endif
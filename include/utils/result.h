@@ -11,25 +11,31 @@ template<typename T>
 struct Result{
 
     public:
-        Result(){}
-
-        ~Result(){}
+        Result() = default;
 
         void set_ok(T val){
-            as = val;
+            as = std::move(val);
         }
 
         void set_error(const std::string& err){
             as = err;
         }
 
-        T get_ok() const {
+        const T& get_ok() const {
             if(is_ok()){return std::get<T>(as);}
             else {
                 throw std::runtime_error(ANNOT("get_ok called on error!"));
             }
         }
 
+        /// @brief Move the value out, for values that can't or shouldn't be copied. Only the error can be asked for afterwards
+        T take_ok(){
+            if(is_ok()){return std::move(std::get<T>(as));}
+            else {
+                throw std::runtime_error(ANNOT("take_ok called on error!"));
+            }
+        }
+
         std::string get_error() const {
             if(is_error()){return std::get<std::string>(as);}
             else {
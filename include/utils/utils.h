@@ -11,16 +11,19 @@
 #include <regex>
 #include <random>
 #include <set>
+#include <map>
 #include <filesystem>
 #include <unordered_map>
+#include <unordered_set>
 #include <algorithm>
 #include <cctype>
 #include <cstdint>
+#include <climits>
 #include <optional>
 #include <array>
 #include <iomanip>
-
-#define WILDCARD_MAX 5
+#include <functional>
+#include <numeric>
 
 #define BIT64(pos) (1ULL << pos)
 
@@ -58,25 +61,31 @@ namespace fs = std::filesystem;
 
 U64 hash_rule_name(std::string rule_name);
 
+U64 hash_file(const fs::path& path, U64 hash = 14695981039346656037ULL);
+
 void lower(std::string& str);
 
-std::mt19937& seed();
+/// @brief Seed of the `index`th stream split off `master`. Nearby masters and indices give unrelated seeds
+U64 split_seed(U64 master, U64 index);
 
-int random_int(int max, int min = 0);
+int random_int(std::mt19937& rng, int max, int min = 0);
 
-float random_float(float max, float min = 0.0);
+float random_float(std::mt19937& rng, float max, float min = 0.0);
 
 std::optional<int> safe_stoi(const std::string& str);
 
+/// @brief All of `str` as a number no larger than `max`. Nullopt if it has a sign or anything else that isn't a digit, or is too large
+std::optional<U64> parse_unsigned(std::string_view str, U64 max = UINT64_MAX);
+
 std::vector<std::vector<int>> n_choose_r(const int n, const int r);
 
 int vector_sum(std::vector<int> in);
 
 int vector_max(std::vector<int> in);
 
-void pipe_to_command(std::string command, std::string write);
+void pipe_to_command(std::string command, std::string write, bool verbose = false);
 
-std::string pipe_from_command(std::string command);
+std::string pipe_from_command(std::string command, bool verbose = false);
 
 std::string escape(const std::string& str);
 
@@ -113,27 +122,97 @@ namespace Common {
     constexpr char TOP_LEVEL_CIRCUIT_NAME[] = "main_circuit";
     constexpr char OUTPUTS_FOLDER_NAME[] = "outputs";
     constexpr char META_GRAMMAR_NAME[] = "meta-grammar";
+    constexpr char GRAMMAR_CACHE_FOLDER_NAME[] = "grammar_cache";
 
     /*
         ast parameters
     */
     constexpr int MIN_N_QUBITS_IN_ENTANGLEMENT = 2;
+    constexpr int WIDEST_GATE_QUBITS = 3; // ccx, cswap
     constexpr int MIN_QUBITS = 3;
     constexpr int MIN_BITS = 1;
     constexpr int MAX_QUBITS = 4; // std::max(MIN_QUBITS + 1, (int)(0.5 * WILDCARD_MAX));
     constexpr int MAX_BITS = 2; // std::max(MIN_BITS + 1, (int)(0.5 * WILDCARD_MAX));
     constexpr int MAX_SUBROUTINES = 2; //  (int)(0.5 * WILDCARD_MAX);
+    constexpr int WILDCARD_MAX = 5;
     constexpr int NESTED_MAX_DEPTH = 2;
     constexpr int SWARM_TESTING_GATESET_SIZE = 6;
 
     /*
-        flags 
+        once a derivation is this deep, or has built this many nodes, only branches that finish as soon as possible are picked
+    */
+    constexpr unsigned int DERIVATION_DEPTH_BUDGET = 128;
+    constexpr unsigned int DERIVATION_NODE_BUDGET = 100000;
+
+    /*
+        derivations that still haven't finished by this many nodes are abandoned
+    */
+    constexpr unsigned int DERIVATION_NODE_LIMIT = 10 * DERIVATION_NODE_BUDGET;
+
+    /*
+        derivations that still haven't finished after this many milliseconds are abandoned, 0 for no time limit. Derivations with a
+        time limit check the clock every `DERIVATION_SLICE` nodes
+    */
+    constexpr unsigned int BUILD_TIME_LIMIT = 0;
+    constexpr unsigned int DERIVATION_SLICE = 4096;
+
+    /*
+        limits on how large a program gets, set per grammar. They start at the constants above, which a grammar can override with
+        `name = value` lines in a `.limits` file next to its definition, and which can be changed from the command line or the REPL
+    */
+    struct Limits {
+        unsigned int min_qubits = MIN_QUBITS;
+        unsigned int max_qubits = MAX_QUBITS;
+        unsigned int min_bits = MIN_BITS;
+        unsigned int max_bits = MAX_BITS;
+        unsigned int max_subroutines = MAX_SUBROUTINES;
+        unsigned int nested_max_depth = NESTED_MAX_DEPTH;
+        unsigned int wildcard_max = WILDCARD_MAX;
+        unsigned int derivation_depth_budget = DERIVATION_DEPTH_BUDGET;
+        unsigned int derivation_node_budget = DERIVATION_NODE_BUDGET;
+        unsigned int derivation_node_limit = DERIVATION_NODE_LIMIT;
+        unsigned int build_time_limit = BUILD_TIME_LIMIT; // ms
+
+        /// @brief Set the limit with this name. False if there is no such limit, or `value` is over INT_MAX
+        bool set(const std::string& name, unsigned int value);
+
+        /// @brief Set the limit in a `name=value` argument. False if it isn't one, or its value is out of range
+        bool set(const std::string& assignment);
+
+        /// @brief Set every limit in a file of `name = value` lines, where `#` starts a comment. Throws on lines that set nothing
+        void load(const fs::path& path);
+
+        /// @brief Throws if the limits contradict each other, i.e a minimum over its maximum, or leave blocks too narrow for the widest gate
+        void check() const;
+
+        friend std::ostream& operator<<(std::ostream& stream, const Limits& limits);
+    };
+
+    /*
+        size asked for by size targeted generation: exactly `n_qubit_ops` qubit ops in the body of the main circuit, a path of 
+        at least `min_depth` of them through its DAG, and `width` qubits in each scope it defines qubits in. A depth or width of 0 
+        is left to chance
+    */
+    struct Size_target {
+        unsigned int n_qubit_ops = 0;
+        unsigned int min_depth = 0;
+        unsigned int width = 0;
+    };
+
+    /*
+        flags, toggled from the REPL. Each run owns a set and passes it down to whatever it generates with.
+        `n_threads` is how many programs are built at once, 0 for one per core, and `size_target` is set for size targeted generation
     */
-    extern bool plot;
-    extern bool verbose;
-    extern bool render_dags;
-    extern bool run_genetic;
-    extern bool swarm_testing;
+    struct Flags {
+        bool plot = false;
+        bool verbose = false;
+        bool render_dags = false;
+        bool run_genetic = false;
+        bool swarm_testing = false;
+        bool streaming = false;
+        unsigned int n_threads = 0;
+        std::optional<Size_target> size_target = std::nullopt;
+    };
 }
 
 #endif
@@ -1,6 +1,8 @@
 #include <ast.h>
 
 #include <sstream>
+#include <utility>
+#include <chrono>
 #include <result.h>
 
 #include <block.h>
@@ -24,52 +26,47 @@
 
 #include <generator.h>
 
-std::string Node::indentation_tracker = "";
+thread_local const std::shared_ptr<Node> Ast::dummy = std::make_shared<Node>("");
 
-
-std::shared_ptr<Node> Ast::get_node(const std::shared_ptr<Node> parent, const Term& term){
+std::shared_ptr<Node> Ast::get_node(const std::shared_ptr<Node> parent, const Ir::Term& term){
 
 	if(parent == nullptr){
 		throw std::runtime_error(ANNOT("Node must have a parent!"));
 	}
 
-	if(term.is_syntax()){
-		// std::cout << term.get_syntax() << std::endl;
-		return std::make_shared<Node>(term.get_syntax());
+	if(term.type == Ir::TERM_SYNTAX){
+		return context.make<Node>(std::string(grammar->string(term.value)));
 	}
 
-	U8 scope = term.get_scope();
+	U8 scope = grammar->term_scope(term);
 
-	std::string str = term.get_string();
-	Token::Kind kind = term.get_kind();
+	std::string str(grammar->term_string(term));
+	Token::Kind kind = term.kind;
 	
 	if(*parent == Token::COMPARE_OP_BITWISE_OR_PAIR){
-		return std::make_shared<Compare_op_bitwise_or_pair_child>(str, kind);
+		return context.make<Compare_op_bitwise_or_pair_child>(str, kind);
 	}
 	
 	switch(kind){
 
 		case Token::INDENT:
-			Node::indentation_tracker += "\t";
+			context.indent();
 			return dummy;
 
 		case Token::DEDENT:
-			if(Node::indentation_tracker.size()){
-				Node::indentation_tracker.pop_back();
-			}
-
+			context.dedent();
 			return dummy;
 
 		/// TODO: add grammar syntax to allow certain rules to exclude other rules downstream, useful for non_comptime_block
 		// case Common::non_comptime_block:
 		// 	context.set_can_apply_subroutines(false);
-		// 	return std::make_shared<Node>(str, hash);
+		// 	return context.make<Node>(str, hash);
 
 		case Token::BLOCK:
 			return context.new_block_node();
 
 		case Token::BODY:
-			return std::make_shared<Node>(str, kind);
+			return context.make<Node>(str, kind);
 
 		case Token::COMPOUND_STMTS:
 			return context.get_compound_stmts(parent);
@@ -84,19 +81,19 @@ std::shared_ptr<Node> Ast::get_node(const std::shared_ptr<Node> parent, const Te
 			return context.get_nested_branch(str, kind, parent);
 
 		case Token::DISJUNCTION:
-			return std::make_shared<Disjunction>();
+			return context.make<Disjunction>();
 
 		case Token::CONJUNCTION:
-			return std::make_shared<Conjunction>();
+			return context.make<Conjunction>();
 
 		case Token::EXPRESSION:
-			return std::make_shared<Expression>();
+			return context.make<Expression>();
 		
 		case Token::CIRCUIT_ID:
 			return context.get_circuit_id();
 
 		case Token::MAIN_CIRCUIT_NAME:				
-			return std::make_shared<Variable>(Common::TOP_LEVEL_CIRCUIT_NAME);
+			return context.make<Variable>(Common::TOP_LEVEL_CIRCUIT_NAME);
 
 		case Token::SUBROUTINE_DEFS:
 			return context.new_subroutines_node();	
@@ -105,7 +102,7 @@ std::shared_ptr<Node> Ast::get_node(const std::shared_ptr<Node> parent, const Te
 			return context.new_qubit_op_node();
 	
 		case Token::CIRCUIT_NAME:
-			return std::make_shared<Variable>(context.get_current_block_owner());
+			return context.make<Variable>(context.get_current_block_owner());
 
 		case Token::QUBIT_DEF_SIZE:
 			return context.get_current_qubit_definition_size();
@@ -141,14 +138,14 @@ std::shared_ptr<Node> Ast::get_node(const std::shared_ptr<Node> parent, const Te
 				num_qubits = context.get_current_gate()->get_num_external_qubits();
 			}
 
-			return std::make_shared<Qubit_list>(num_qubits);
+			return context.make<Qubit_list>(num_qubits);
 		}
 
 		case Token::BIT_LIST:
-			return std::make_shared<Bit_list>(context.get_current_gate()->get_num_external_bits());
+			return context.make<Bit_list>(context.get_current_gate()->get_num_external_bits());
 
 		case Token::FLOAT_LIST:
-			return std::make_shared<Float_list>(context.get_current_gate()->get_num_floats());
+			return context.make<Float_list>(context.get_current_gate()->get_num_floats());
 
 		case Token::QUBIT_INDEX:
 			return context.get_current_qubit_index();
@@ -169,13 +166,13 @@ std::shared_ptr<Node> Ast::get_node(const std::shared_ptr<Node> parent, const Te
 			return context.new_bit();
 		
 		case Token::FLOAT_LITERAL:
-			return std::make_shared<Float>();
+			return context.make<Float>(context.rng());
 
 		case Token::NUMBER:
-			return std::make_shared<Integer>();
+			return context.make<Integer>();
 
 		case Token::GATE_MAME:
-			return std::make_shared<Gate_name>(parent, context.get_current_block(), swarm_testing_gateset);
+			return context.make<Gate_name>(parent, context.get_current_block(), swarm_testing_gateset);
 
 		case Token::SUBROUTINE: {
 			std::shared_ptr<Block> subroutine = context.get_random_block();
@@ -186,13 +183,13 @@ std::shared_ptr<Node> Ast::get_node(const std::shared_ptr<Node> parent, const Te
 				- we can then use the hash later to detect which gate nodes are subroutines, and get their names by getting the string of the node 
 			*/
 
-			subroutine->print_info();
+			subroutine->print_info(*report);
 
 			return context.new_gate(subroutine->get_owner(), kind, subroutine->get_qubit_defs());
 		}
 
 		case Token::SUBROUTINE_OP_ARGS:
-			return std::make_shared<Subroutine_op_args>(context.get_current_gate()->get_num_external_qubit_defs());
+			return context.make<Subroutine_op_args>(context.get_current_gate()->get_num_external_qubit_defs());
 
 		case Token::SUBROUTINE_OP_ARG:
 			return context.new_arg();
@@ -227,80 +224,427 @@ std::shared_ptr<Node> Ast::get_node(const std::shared_ptr<Node> parent, const Te
 		case Token::BARRIER: {
 			std::shared_ptr<Block> current_block = context.get_current_block();
 
-			unsigned int n_qubits = std::min((unsigned int)WILDCARD_MAX, (unsigned int)current_block->num_qubits_of(ALL_SCOPES));
-			unsigned int random_barrier_width = random_int(n_qubits, 1);
+			unsigned int n_qubits = std::min((unsigned int)context.get_limits().wildcard_max, (unsigned int)current_block->num_qubits_of(ALL_SCOPES));
+			unsigned int random_barrier_width = random_int(context.rng(), n_qubits, 1);
 
 			return context.new_gate(str, kind, random_barrier_width, 0, 0);
 		}
 
 		case Token::GATE_OP_ARGS:
-			return std::make_shared<Gate_op_args>(context.get_current_gate());
+			return context.make<Gate_op_args>(context.get_current_gate());
 
 		default:
-			return std::make_shared<Node>(str, kind);
+			return context.make<Node>(str, kind);
 	}
 
 }
 
-void Ast::write_branch(std::shared_ptr<Node> parent, const Term& term){
+void Ast::set_weight(Ir::Index rule, Ir::Index offset, float weight){
+	const Ir::Rule& r = grammar->rule(rule);
+	std::vector<float> weights;
 
-	if(term.is_rule()){
+	weight_overrides[r.first_branch + offset] = weight;
 
-		Branch branch = term.get_rule()->pick_branch(parent);
+	for(Ir::Index b = r.first_branch; b < r.first_branch + r.n_branches; b++){
+		weights.push_back(branch_weight(b));
+	}
 
-		for(const Term& child_term : branch){
-			
-			std::shared_ptr<Node> child_node = get_node(parent, child_term);
+	alias_overrides[rule] = Alias_table(weights);
+
+	// the alias tables of cached candidates were built from the old weights
+	constraint_index.clear();
+}
+
+void Ast::reset_weights(){
+	weight_overrides.clear();
+	alias_overrides.clear();
+	constraint_index.clear();
+}
+
+size_t Ast::pick_weighted(const std::vector<Ir::Index>& branches){
+	float total = 0.0f;
+
+	for(Ir::Index b : branches) total += branch_weight(b);
+
+	if(total <= 0.0f) return random_int(context.rng(), branches.size() - 1);
+
+	float x = random_float(context.rng(), total);
+
+	for(size_t i = 0; i < branches.size(); i++){
+		x -= branch_weight(branches[i]);
+		if(x < 0.0f) return i;
+	}
+
+	// only reachable through rounding
+	return branches.size() - 1;
+}
+
+std::optional<Ir::Index> Ast::pick_branch(Ir::Index rule, const std::shared_ptr<Node> parent, std::vector<unsigned int>& repetitions){
+	const Ir::Rule& r = grammar->rule(rule);
+
+	if(r.n_branches == 0){
+		#ifdef DEBUG
+		INFO(std::string(grammar->rule_name(rule)) + STR_SCOPE(r.scope) + " is an empty rule");
+		#endif
+
+		return std::nullopt;
+	}
+
+	#ifdef DEBUG
+	INFO("Picking branch for " + std::string(grammar->rule_name(rule)) + STR_SCOPE(r.scope) + " while satisfying constraint " + parent->get_debug_constraint_string());
+	#endif
+
+	const Node_constraint* constraint = parent->get_constraint();
+
+	// past the budget, stick to branches that finish as soon as possible, unless the rule has none
+	const Common::Limits& limits = context.get_limits();
+	bool out_of_budget = (depth >= limits.derivation_depth_budget) || (n_nodes >= limits.derivation_node_budget);
+
+	auto terminating = [&](const std::vector<Ir::Index>& branches){
+		std::vector<Ir::Index> out;
+
+		for(Ir::Index b : branches){
+			if(grammar->is_terminating_branch(rule, b)) out.push_back(b);
+		}
+
+		return out;
+	};
+
+	if(constraint == nullptr){
+		Ir::Index branch = r.first_branch + rule_alias_table(rule).sample(context.rng());
+
+		if(out_of_budget && !grammar->is_terminating_branch(rule, branch)){
+			std::vector<Ir::Index> all(r.n_branches);
+			std::iota(all.begin(), all.end(), r.first_branch);
+
+			std::vector<Ir::Index> finishing = terminating(all);
+
+			if(finishing.size()) branch = finishing[pick_weighted(finishing)];
+		}
+
+		repetitions = grammar->random_repetitions(branch, context.rng(), limits.wildcard_max, out_of_budget);
+		return branch;
+	}
+
+	auto key = std::make_pair(rule, constraint->key());
+	auto it = constraint_index.find(key);
+
+	if(it == constraint_index.end()){
+		Candidates candidates;
+		std::vector<float> weights;
+
+		for(Ir::Index b = r.first_branch; b < r.first_branch + r.n_branches; b++){
+			if(constraint->may_pass(*grammar, b)){
+				candidates.branches.push_back(b);
+				weights.push_back(branch_weight(b));
+			}
+		}
+
+		candidates.alias = Alias_table(weights);
+
+		it = constraint_index.emplace(std::move(key), std::move(candidates)).first;
+	}
+
+	/*
+		branches without repetitions in the index are known to pass. Those with repetitions can still fail to find counts, 
+		in which case they are dropped from a copy of the candidates for the rest of this pick. Only the full set of candidates 
+		has an alias table, anything smaller is sampled by weight directly. Past the budget, the terminating candidates are tried
+		first, and the others only once none of those can satisfy the constraint, so the budget never leaves a node without a branch
+	*/
+	const std::vector<Ir::Index>& all = it->second.branches;
+	const std::vector<Ir::Index>* pool = &all;
+	std::vector<Ir::Index> remaining, fallback;
+
+	if(out_of_budget){
+		remaining = terminating(all);
+
+		if(remaining.size()){
+			pool = &remaining;
+
+			for(Ir::Index b : all){
+				if(!grammar->is_terminating_branch(rule, b)) fallback.push_back(b);
+			}
+		}
+	}
+
+	while(!pool->empty() || !fallback.empty()){
+		if(pool->empty()){
+			remaining = std::move(fallback);
+			fallback.clear();
+		}
+
+		size_t index = (pool == &all) ? it->second.alias.sample(context.rng()) : pick_weighted(*pool);
+		Ir::Index branch = (*pool)[index];
+
+		std::optional<std::vector<unsigned int>> counts = constraint->solve(*grammar, branch, context.rng(), limits.wildcard_max);
+
+		if(counts.has_value()){
+			repetitions = std::move(counts.value());
+			return branch;
+		}
+
+		if(pool == &all){
+			remaining = all;
+			pool = &remaining;
+		}
+
+		remaining[index] = remaining.back();
+		remaining.pop_back();
+	}
+
+	throw std::runtime_error(ANNOT("No branch of " + std::string(grammar->rule_name(rule)) + STR_SCOPE(r.scope) + " can satisfy constraint " + parent->get_debug_constraint_string()));
+}
+
+void Ast::push_frame(const std::shared_ptr<Node>& node, const Ir::Term& term, bool prints_children){
+	Frame frame{.node = node, .first_term = terms.size(), .next_term = terms.size(), .end_term = terms.size(), .picked_branch = false,
+		.prints_children = prints_children, .keeps_children = false};
+
+	if(sink != nullptr){
+		frame.keeps_children = node->keeps_children();
+
+		n_muted += !prints_children;
+		n_keeping += frame.keeps_children;
+	}
+
+	if(term.type == Ir::TERM_RULE){
+		std::optional<Ir::Index> branch = pick_branch(term.value, node, repetitions);
+
+		if(branch.has_value()){
+			depth++;
+			frame.picked_branch = true;
+
+			grammar->for_each_term(branch.value(), repetitions, [&](const Ir::Term& child_term){
+				terms.push_back(&child_term);
+			});
+
+			frame.end_term = terms.size();
+		}
+	}
+
+	stack.push_back(std::move(frame));
+}
+
+void Ast::derive_child(const Ir::Term& term){
+	std::shared_ptr<Node> parent = stack.back().node;
+	std::shared_ptr<Node> child = get_node(parent, term);
+
+	n_nodes++;
+
+	if(sink == nullptr){
+		context.add_child(*parent, child);
+
+		if((child->get_num_children() == 0) && (child != dummy)) push_frame(child, term, false);
+
+		return;
+	}
+
+	// streamed children are only kept under nodes that print them again
+	if(n_keeping) context.add_child(*parent, child);
+
+	bool printing = (n_muted == 0);
+
+	if(printing) sink->before_child(*parent);
+
+	bool prints_children = printing && sink->enter(*child);
 
-			parent->add_child(child_node);
+	if(child->get_num_children() || (child == dummy)){
+		// made with its children, derived before and kept them, or the dummy, which has none
+		if(prints_children) sink->emit_children(*child);
+		if(printing) sink->after_child(*parent);
+
+	} else {
+		push_frame(child, term, prints_children);
+	}
+}
 
-			if(child_node->get_num_children()) continue;
+Derivation_status Ast::derive(unsigned int max_nodes){
+	unsigned int first_node = n_nodes;
 
-			write_branch(child_node, child_term);
+	while(stack.size()){
+		Frame& frame = stack.back();
 
+		if(frame.next_term == frame.end_term){
+			// done
+			if(frame.picked_branch) depth--;
+
+			frame.node->transition_to_done();
+			terms.resize(frame.first_term);
+
+			bool printed = frame.prints_children;
+			bool kept = frame.keeps_children;
+
+			stack.pop_back();
+
+			if(sink != nullptr){
+				n_muted -= !printed;
+				n_keeping -= kept;
+
+				if((n_muted == 0) && stack.size()) sink->after_child(*stack.back().node);
+			}
+
+			continue;
 		}
+
+		if(cancelled.load(std::memory_order_relaxed)) return DS_CANCELLED;
+
+		if(n_nodes >= context.get_limits().derivation_node_limit) return DS_OVER_BUDGET;
+
+		if(n_nodes - first_node >= max_nodes) return DS_SUSPENDED;
+
+		derive_child(*terms[frame.next_term++]);
 	}
 
-	// done
-	parent->transition_to_done();
+	return DS_DONE;
 }
 
-Result<Node> Ast::build(const std::optional<Genome>& genome, std::optional<Node_constraint>& _swarm_testing_gateset){
-	Result<Node> res;
+bool Ast::start(std::optional<Genome>&& genome, std::optional<Node_constraint>& _swarm_testing_gateset, std::ostream& _report, Emitter* _sink){
+
+	if(!entry.has_value()) return false;
+
+	start_rng = context.rng();
+	cancelled.store(false, std::memory_order_relaxed);
 
-	if(entry == nullptr){
-		res.set_error("Entry point not set");
+	report = &_report;
+	sink = _sink;
+	swarm_testing_gateset = _swarm_testing_gateset;
 
+	from_genome = genome.has_value();
+
+	if(from_genome){
+		// the program is built by walking the genome's DAG, which it then keeps
+		dag = std::move(genome.value().dag);
 	} else {
+		// a build that failed part way may have streamed some of its qubit ops in already
+		dag.reset();
+	}
+
+	context.reset(Context::PROGRAM);
+	context.set_genome_dag(from_genome ? &dag : nullptr);
+	// programs from a genome already have their DAG, so none is streamed for them
+	context.set_streaming(((sink != nullptr) && !from_genome) ? &dag : nullptr);
+
+	stack.clear();
+	terms.clear();
+	depth = 0;
+	n_nodes = 0;
+	n_muted = 0;
+	n_keeping = 0;
 
-		swarm_testing_gateset = _swarm_testing_gateset;
+	Ir::Term entry_term{.kind = grammar->rule(entry.value()).kind, .value = entry.value(), .min_repetitions = 0, .max_repetitions = 0, .type = Ir::TERM_RULE, .open_ended = 0};
 
-		context.reset(Context::PROGRAM);
-		context.set_genome(genome);
+	root = get_node(std::make_shared<Node>(""), entry_term);
 
-		Term entry_term(entry, entry->get_token().kind);
+	bool prints_children = false;
 
-		std::shared_ptr<Node> root = get_node(std::make_shared<Node>(""), entry_term);
+	if(sink != nullptr){
+		// the root has no parent, so only what comes before its children is printed here
+		prints_children = sink->enter(*root);
 
-		write_branch(root, entry_term);
+		if(prints_children) sink->emit_children(*root);
+	}
+
+	push_frame(root, entry_term, prints_children);
+
+	return true;
+}
+
+std::optional<Derivation_state> Ast::save() const {
+	if(from_genome) return std::nullopt;
+
+	return Derivation_state{.rng = start_rng, .swarm_testing_gateset = swarm_testing_gateset, .n_nodes = n_nodes};
+}
+
+bool Ast::resume(const Derivation_state& state, std::ostream& _report, Emitter* _sink){
+	std::optional<Node_constraint> gateset = state.swarm_testing_gateset;
+
+	context.rng() = state.rng;
+
+	if(!start(std::nullopt, gateset, _report, _sink)) return false;
+
+	Derivation_status status = derive(state.n_nodes);
+
+	// the replay has to get exactly as far as the saved build had, anything else means this builder can't make the same program
+	return ((status == DS_SUSPENDED) || (status == DS_DONE)) && (n_nodes == state.n_nodes);
+}
+
+Result<Program> Ast::finish(){
+	Result<Program> res;
+
+	// a streamed DAG was filled in as the qubit ops were made
+	if(!from_genome && (sink == nullptr)){
+		std::shared_ptr<Block> main_circuit_block = context.get_current_block();
+		dag.make_dag(main_circuit_block);
+	}
+
+	context.print_block_info(*report);
+
+	*report << dag << std::endl;
+
+	// a genome's DAG already holds the table its qubit ops were made in
+	if(!from_genome) dag.keep_nodes(context.get_nodes());
+
+	// the program takes the tree and the DAG as they are, the next build starts from a DAG of its own
+	res.set_ok(Program(std::move(root), context.get_nodes(), std::exchange(dag, Dag::Dag())));
+
+	return res;
+}
+
+Result<Program> Ast::build(std::optional<Genome>&& genome, std::optional<Node_constraint>& _swarm_testing_gateset, std::ostream& _report, Emitter* _sink){
+	Result<Program> res;
+
+	try {
+		if(!start(std::move(genome), _swarm_testing_gateset, _report, _sink)){
+			res.set_error("Entry point not set");
+			return res;
+		}
+
+		unsigned int time_limit = context.get_limits().build_time_limit;
+		Derivation_status status;
+
+		if(time_limit == 0){
+			status = derive();
 
-		if(genome.has_value()){
-			dag = genome.value().dag;
 		} else {
-			std::shared_ptr<Block> main_circuit_block = context.get_current_block();
-			dag.make_dag(main_circuit_block);
+			// a slice at a time, so that the clock isn't read at every node
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(time_limit);
+
+			do {
+				status = derive(Common::DERIVATION_SLICE);
+			} while((status == DS_SUSPENDED) && (std::chrono::steady_clock::now() < deadline));
 		}
 
-		context.print_block_info();
+		switch(status){
+			case DS_DONE:
+				return finish();
+
+			case DS_OVER_BUDGET:
+				res.set_error("Build abandoned after " + std::to_string(n_nodes) + " nodes");
+				break;
+
+			case DS_SUSPENDED:
+				res.set_error("Build abandoned after " + std::to_string(time_limit) + " ms, at " + std::to_string(n_nodes) + " nodes");
+				break;
 
-		std::cout << dag << std::endl;
+			case DS_CANCELLED:
+				res.set_error("Build cancelled at " + std::to_string(n_nodes) + " nodes");
+				break;
+		}
 
-		res.set_ok(*root);
+	} catch (const std::runtime_error& error) {
+		res.set_error(error.what());
 	}
 
 	return res;
 }
 
-Genome Ast::genome(){
-	return Genome{.dag = dag, .dag_score = dag.score()};
-}
\ No newline at end of file
+std::shared_ptr<Ast> Ast::fork() const {
+	std::shared_ptr<Ast> ast = std::make_shared<Ast>();
+
+	ast->grammar = grammar;
+	ast->entry = entry;
+	ast->weight_overrides = weight_overrides;
+	ast->alias_overrides = alias_overrides;
+	ast->set_limits(get_limits());
+
+	return ast;
+}
@@ -3,24 +3,39 @@
 
 namespace Context {
 
+    thread_local const std::shared_ptr<Block> Context::dummy_block = std::make_shared<Block>();
+
     void Context::reset(Level l){
 
         if(l == PROGRAM){
             subroutine_counter = 0;
-            Node::node_counter = 0;
+            node_counter = 0;
+            indent_depth = 0;
+
+            // the last program's nodes are freed together once nothing holds them, size the next arena after it
+            arena = std::make_shared<Arena>(arena->get_bytes_used());
+            nodes = std::make_shared<Node_table>();
             can_copy_dag = false;
+            partitioning = false;
+            n_spine_ops = 0;
+            n_placed_ops = 0;
+            spine_qubit = std::nullopt;
 
             blocks.clear();
+            n_settled_blocks = 0;
+            min_subroutine_external_qubits = SIZE_MAX;
 
             subroutines_node = std::nullopt;
-            genome = std::nullopt;
+            genome_dag = nullptr;
 
         } else if (l == BLOCK){
-            nested_depth = Common::NESTED_MAX_DEPTH;
+            nested_depth = limits.nested_max_depth;
 
         } else if (l == QUBIT_OP){
-            get_current_block()->qubit_flag_reset();
-            get_current_block()->bit_flag_reset();
+            if(blocks.size()){
+                blocks.back()->qubit_flag_reset();
+                blocks.back()->bit_flag_reset();
+            }
 
             current_port = 0;
         }
@@ -41,19 +56,32 @@ namespace Context {
     }
 
     void Context::set_can_apply_subroutines(){
+        if(blocks.empty()) return;
+
         std::shared_ptr<Block> current_block = get_current_block();
 
-        for(std::shared_ptr<Block> block : blocks){
-            if (can_apply_subroutine(current_block, block))
-            {
-                #ifdef DEBUG
-                INFO("Block " + current_block_owner + " can apply subroutines");
-                #endif
+        /*
+            every block before the current one is finished, so the fewest external qubits of any subroutine among them is kept up to 
+            date as blocks are added, instead of checking every earlier block each time. A subroutine fits where `can_apply_subroutine`
+            says it does exactly when that fewest number fits
+        */
+        for(; n_settled_blocks + 1 < blocks.size(); n_settled_blocks++){
+            const std::shared_ptr<Block>& block = blocks[n_settled_blocks];
+            size_t num_external_qubits = block->num_qubits_of(EXTERNAL_SCOPE);
 
-                return;
+            if(!block->owned_by(Common::TOP_LEVEL_CIRCUIT_NAME) && (num_external_qubits >= 1)){
+                min_subroutine_external_qubits = std::min(min_subroutine_external_qubits, num_external_qubits);
             }
         }
 
+        if(min_subroutine_external_qubits <= std::min(current_block->num_qubits_of(ALL_SCOPES), current_block->num_bits_of(ALL_SCOPES))){
+            #ifdef DEBUG
+            INFO("Block " + current_block_owner + " can apply subroutines");
+            #endif
+
+            return;
+        }
+
         #ifdef DEBUG
         INFO("Block " + current_block_owner + " can't apply subroutines");
         #endif
@@ -62,7 +90,7 @@ namespace Context {
     }
 
     unsigned int Context::get_max_external_qubits(){
-        size_t res = Common::MIN_QUBITS;
+        size_t res = limits.min_qubits;
 
         for(const std::shared_ptr<Block>& block : blocks){
             res = std::max(res, block->num_qubits_of(EXTERNAL_SCOPE));
@@ -72,7 +100,7 @@ namespace Context {
     }
 
     unsigned int Context::get_max_external_bits(){
-        size_t res = Common::MIN_BITS;
+        size_t res = limits.min_bits;
 
         for(const std::shared_ptr<Block>& block : blocks){
             res = std::max(res, block->num_bits_of(EXTERNAL_SCOPE));
@@ -96,7 +124,7 @@ namespace Context {
     std::shared_ptr<Block> Context::get_random_block(){
         if(blocks.size()){
 
-            std::shared_ptr<Block> block = blocks.at(random_int(blocks.size()-1));
+            std::shared_ptr<Block> block = blocks.at(random_int(random_gen, blocks.size()-1));
             std::shared_ptr<Block> current_block = get_current_block();
 
             #ifdef DEBUG
@@ -104,7 +132,7 @@ namespace Context {
             #endif
             
             while(!can_apply_subroutine(current_block, block)){
-                block = blocks.at(random_int(blocks.size()-1));
+                block = blocks.at(random_int(random_gen, blocks.size()-1));
             }
 
             return block;
@@ -121,28 +149,33 @@ namespace Context {
 
         if(current_block_is_subroutine()){
 
-            if(genome.has_value()){
-                std::shared_ptr<Node> subroutine = genome.value().dag.get_next_subroutine_gate();
+            if(genome_dag != nullptr){
+                std::shared_ptr<Node> subroutine = genome_dag->get_next_subroutine_gate();
 
                 std::cout << YELLOW("setting block from DAG ") << std::endl;
                 std::cout << YELLOW("owner: " + subroutine->get_content()) << std::endl; 
                 std::cout << YELLOW("n ports: " + std::to_string(subroutine->get_n_ports())) << std::endl; 
 
                 current_block_owner = subroutine->get_content();
-                current_block = std::make_shared<Block>(current_block_owner, subroutine->get_n_ports());
+                current_block = make<Block>(current_block_owner, subroutine->get_n_ports(), limits, random_gen);
 
             } else {
                 current_block_owner = "sub"+std::to_string(subroutine_counter++);
-                current_block = std::make_shared<Block>(current_block_owner);
+                current_block = make<Block>(current_block_owner, limits, random_gen);
             }
 
         } else {
             current_block_owner = Common::TOP_LEVEL_CIRCUIT_NAME;
-            current_block = std::make_shared<Block>(Common::TOP_LEVEL_CIRCUIT_NAME);
+            current_block = make<Block>(Common::TOP_LEVEL_CIRCUIT_NAME, limits, random_gen);
 
             subroutine_counter = 0;
 
-            can_copy_dag = genome.has_value();
+            can_copy_dag = (genome_dag != nullptr);
+            partitioning = can_copy_dag || size_target.has_value();
+
+            if(!can_copy_dag && size_target.has_value() && size_target->width){
+                current_block->set_target_num_qubits(size_target->width);
+            }
         }
 
         blocks.push_back(current_block);
@@ -151,32 +184,36 @@ namespace Context {
     }
 
     std::shared_ptr<Qubit_defs> Context::get_qubit_defs_node(U8& scope){
+        if(blocks.empty()) return make<Qubit_defs>(indent_depth, 0);
+
         std::shared_ptr<Block> current_block = get_current_block();
 
         unsigned int num_defs;
 
         if(can_copy_dag){
-            num_defs = current_block->make_resource_definitions(genome->dag, scope, Resource::QUBIT);
+            num_defs = current_block->make_resource_definitions(*genome_dag, scope, Resource::QUBIT);
         
         } else {
-            num_defs = current_block->make_resource_definitions(scope, Resource::QUBIT);
+            num_defs = current_block->make_resource_definitions(random_gen, scope, Resource::QUBIT);
         }
         
-        return std::make_shared<Qubit_defs>(num_defs);
+        return make<Qubit_defs>(indent_depth, num_defs);
     }
 
     std::shared_ptr<Bit_defs> Context::get_bit_defs_node(U8& scope){
+        if(blocks.empty()) return make<Bit_defs>(indent_depth, 0);
+
         std::shared_ptr<Block> current_block = get_current_block();
 
         unsigned int num_defs;
         
         if(can_copy_dag){
-            num_defs = current_block->make_resource_definitions(genome->dag, scope, Resource::BIT);
+            num_defs = current_block->make_resource_definitions(*genome_dag, scope, Resource::BIT);
         } else {
-            num_defs = current_block->make_resource_definitions(scope, Resource::BIT);
+            num_defs = current_block->make_resource_definitions(random_gen, scope, Resource::BIT);
         }
     
-        return std::make_shared<Bit_defs>(num_defs);
+        return make<Bit_defs>(indent_depth, num_defs);
     }
 
     std::optional<std::shared_ptr<Block>> Context::get_block(std::string owner){
@@ -192,26 +229,66 @@ namespace Context {
     std::shared_ptr<Resource::Qubit> Context::new_qubit(){
         // U8 scope = (*current_gate == Common::Measure) ? OWNED_SCOPE : ALL_SCOPES;
 
-        auto random_qubit = get_current_block()->get_random_qubit(ALL_SCOPES); 
+        std::shared_ptr<Block> current_block = get_current_block();
+        std::shared_ptr<Resource::Qubit> random_qubit;
+
+        if(partitioning && !can_copy_dag && (current_port == 0) && on_spine(current_block->num_qubits_of(ALL_SCOPES))){
+            random_qubit = current_block->take_qubit(spine_qubit.value());
+
+        } else {
+            random_qubit = unshared(current_block->get_random_qubit(random_gen, ALL_SCOPES));
+        }
         
-        random_qubit->extend_flow_path(current_qubit_op, current_port++);
+        if(streamed_dag == nullptr){
+            random_qubit->extend_flow_path(current_qubit_op, current_port);
+
+        } else if(!current_block_is_subroutine() && current_block->num_qubits_of(ALL_SCOPES)){
+            // blocks with no qubits hand out the dummy qubit, which isn't part of the main circuit's DAG
+            streamed_dag->extend(*random_qubit, current_qubit_op);
+        }
+
+        current_port++;
 
         current_qubit = random_qubit;
 
         return current_qubit;
     }
 
+    /// @brief Whether the qubit op being built in a size targeted block goes on its spine. `min_depth` of its `n_qubit_ops` qubit ops
+    /// are picked uniformly by selection sampling, and all act on the same qubit, picked when the first qubit op is built
+    /// @param n_qubits 
+    /// @return 
+    bool Context::on_spine(size_t n_qubits){
+        if(n_qubits == 0) return false;
+
+        if(!spine_qubit.has_value()){
+            spine_qubit = random_int(random_gen, n_qubits - 1);
+        }
+
+        unsigned int n_spine_left = size_target->min_depth - n_spine_ops;
+        unsigned int n_ops_left = (n_placed_ops < size_target->n_qubit_ops) ? size_target->n_qubit_ops - n_placed_ops : 0;
+
+        n_placed_ops++;
+
+        if(n_spine_left && ((n_ops_left <= n_spine_left) || (random_int(random_gen, n_ops_left - 1) < (int)n_spine_left))){
+            n_spine_ops++;
+            return true;
+        }
+
+        return false;
+    }
+
     std::shared_ptr<Integer> Context::get_current_qubit_index(){
         if(current_qubit != nullptr){
             return current_qubit->get_index();
         } else {
             WARNING("Current qubit not set but trying to get index! Using dummy instead");
-            return std::make_shared<Integer>(dummy_int);
+            return make<Integer>(dummy_int);
         }
     }
 
     std::shared_ptr<Resource::Bit> Context::new_bit(){
-        auto random_bit = get_current_block()->get_random_bit(ALL_SCOPES);
+        auto random_bit = unshared(get_current_block()->get_random_bit(random_gen, ALL_SCOPES));
         current_bit = random_bit;
         
         return current_bit;
@@ -222,7 +299,7 @@ namespace Context {
             return current_bit->get_index();
         } else {
             WARNING("Current bit not set but trying to get index! Using dummy instead");
-            return std::make_shared<Integer>(dummy_int);
+            return make<Integer>(dummy_int);
         }
     }
 
@@ -231,7 +308,7 @@ namespace Context {
             return current_qubit->get_name();
         } else {
             WARNING("Current qubit not set but trying to get name! Using dummy instead");
-            return std::make_shared<Variable>(dummy_var);
+            return make<Variable>(dummy_var);
         }
     }
 
@@ -240,7 +317,7 @@ namespace Context {
             return current_bit->get_name();
         } else {
             WARNING("Current bit not set but trying to get name! Using dummy instead");
-            return std::make_shared<Variable>(dummy_var);
+            return make<Variable>(dummy_var);
         }
     }
 
@@ -249,7 +326,7 @@ namespace Context {
             return current_qubit_definition->get_size();
         } else  {
             WARNING("Current qubit not set but trying to get size! Using dummy instead");
-            return std::make_shared<Integer>(dummy_int);
+            return make<Integer>(dummy_int);
         }
     }
 
@@ -258,7 +335,7 @@ namespace Context {
             return current_qubit_definition->get_name();
         } else {
             WARNING("Current qubit not set but trying to get name! Using dummy instead");
-            return std::make_shared<Variable>(dummy_var);
+            return make<Variable>(dummy_var);
         }
     }
 
@@ -267,7 +344,7 @@ namespace Context {
             return current_bit_definition->get_size();
         } else {
             WARNING("Current bit definition not set or is singular but trying to get size! Using dummy instead");
-            return std::make_shared<Integer>(dummy_int);
+            return make<Integer>(dummy_int);
         }
     }
 
@@ -276,36 +353,36 @@ namespace Context {
             return current_bit_definition->get_name();
         } else {
             WARNING("Current bit definition not set but trying to get name! Using dummy instead");
-            return std::make_shared<Variable>(dummy_var);
+            return make<Variable>(dummy_var);
         }
     }
 
     std::shared_ptr<Nested_branch> Context::get_nested_branch(const std::string& str, const Token::Kind& kind, std::shared_ptr<Node> parent){
-        if(can_copy_dag){
-            return std::make_shared<Nested_branch>(str, kind, parent->get_next_child_target());
+        if(partitioning){
+            return make<Nested_branch>(str, kind, indent_depth, random_gen, parent->get_next_child_target());
 
         } else {
-            return std::make_shared<Nested_branch>(str, kind);
+            return make<Nested_branch>(str, kind, indent_depth);
         }
     }
 
     std::shared_ptr<Nested_stmt> Context::get_nested_stmt(const std::string& str, const Token::Kind& kind, std::shared_ptr<Node> parent){
         nested_depth -= 1;
 
-        if(can_copy_dag){
-            return std::make_shared<Nested_stmt>(str, kind, parent->get_next_child_target());
+        if(partitioning){
+            return make<Nested_stmt>(str, kind, random_gen, parent->get_next_child_target());
 
         } else {
-            return std::make_shared<Nested_stmt>(str, kind);
+            return make<Nested_stmt>(str, kind);
         }
     }
 
     std::shared_ptr<Compound_stmt> Context::get_compound_stmt(std::shared_ptr<Node> parent){
         
-        if(can_copy_dag){
-            return Compound_stmt::from_num_qubit_ops(parent->get_next_child_target());
+        if(partitioning){
+            return make<Compound_stmt>(Compound_stmt::from_num_qubit_ops(indent_depth, random_gen, parent->get_next_child_target()));
         } else {
-            return Compound_stmt::from_nested_depth(nested_depth);
+            return make<Compound_stmt>(Compound_stmt::from_nested_depth(indent_depth, nested_depth));
         }
     
     }
@@ -321,34 +398,38 @@ namespace Context {
             set_can_apply_subroutines();
 
             if(can_copy_dag){
-                parent->make_partition(genome.value().dag.n_qubit_ops(), 1);
+                parent->make_partition(random_gen, genome_dag->n_qubit_ops(), 1);
+
+            } else if(partitioning){
+                parent->make_partition(random_gen, size_target->n_qubit_ops, 1);
             }
         }
 
         if(can_copy_dag){
-            return Compound_stmts::from_num_qubit_ops(parent->get_next_child_target());
+            return make<Compound_stmts>(Compound_stmts::from_num_qubit_ops(random_gen, parent->get_next_child_target(), limits.wildcard_max));
+
+        } else if(partitioning){
+            // one qubit op per statement, so grammars without control flow can meet the target too
+            unsigned int target = parent->get_next_child_target();
+            return make<Compound_stmts>(Compound_stmts::from_num_qubit_ops(random_gen, target, target));
 
         } else {
-            return Compound_stmts::from_num_compound_stmts(WILDCARD_MAX);
+            return make<Compound_stmts>(Compound_stmts::from_num_compound_stmts(limits.wildcard_max));
         }   
     }
 
     std::shared_ptr<Subroutine_defs> Context::new_subroutines_node(){
-        unsigned int n_blocks = random_int(Common::MAX_SUBROUTINES);
+        unsigned int n_blocks = random_int(random_gen, limits.max_subroutines);
 
-        if(genome.has_value()){
-            n_blocks = genome.value().dag.n_subroutines();
+        if(genome_dag != nullptr){
+            n_blocks = genome_dag->n_subroutines();
         }
 
-        std::shared_ptr<Subroutine_defs> node = std::make_shared<Subroutine_defs>(n_blocks);
+        std::shared_ptr<Subroutine_defs> node = make<Subroutine_defs>(n_blocks);
 
         subroutines_node = std::make_optional<std::shared_ptr<Subroutine_defs>>(node);
 
         return node;
     }
 
-    void Context::set_genome(const std::optional<Genome>& _genome){
-        genome = _genome;
-    }
-
 }
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include <emitter.h>
+#include <float.h>
+
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+/// @brief Write all of `size` bytes, which takes one call unless the kernel takes less than the whole buffer
+static void write_all(int fd, const char* data, size_t size, const fs::path& path){
+
+    while(size){
+        ssize_t written = write(fd, data, size);
+
+        if(written < 0){
+            if(errno == EINTR) continue;
+
+            throw std::runtime_error(ANNOT("Cannot write " + path.string() + ": " + std::strerror(errno)));
+        }
+
+        data += written;
+        size -= written;
+    }
+}
+
+Emitter::~Emitter(){
+    if(fd >= 0) close(fd);
+}
+
+void Emitter::append_float(float num){
+    // fixed with 6 decimals, as the program text has always had them
+    char digits[64];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), num, std::chars_format::fixed, 6);
+
+    buffer.append(digits, result.ptr);
+}
+
+bool Emitter::enter(const Node& node){
+    maybe_flush();
+
+    switch(node.layout){
+        case NL_FLOAT:
+            append_float(static_cast<const Float&>(node).get_num());
+            return false;
+
+        case NL_DEFAULT:
+            if(node.kind == Token::SYNTAX){
+                buffer.append(node.content);
+                return false;
+            }
+
+            return true;
+
+        case NL_INDENT_ONCE:
+            buffer.append(node.indentation());
+            return true;
+
+        case NL_SPACE_BEFORE: case NL_SPACE_AROUND:
+            buffer.push_back(' ');
+            return true;
+
+        case NL_SPACE_AFTER:
+            // the spaces come after each child, in `after_child`
+            return true;
+    }
+
+    return true;
+}
+
+void Emitter::emit(const Node& root){
+    if(enter(root)) emit_children(root);
+}
+
+void Emitter::emit_children(const Node& node){
+    // the children are walked along their links in the node's table, which nodes without children don't have
+    auto first_link = [](const Node& n){
+        return n.get_num_children() ? n.table->first_child(n.row) : Node_table::NONE;
+    };
+
+    stack.clear();
+    stack.push_back(Frame{.node = &node, .next_link = first_link(node), .started = false});
+
+    while(stack.size()){
+        Frame& frame = stack.back();
+        const Node& parent = *frame.node;
+
+        // the previous child is done, whether it was pushed or not
+        if(frame.started) after_child(parent);
+
+        if(frame.next_link == Node_table::NONE){
+            stack.pop_back();
+            continue;
+        }
+
+        const Node& child = parent.table->child(frame.next_link);
+
+        frame.next_link = parent.table->next_sibling(frame.next_link);
+        frame.started = true;
+
+        before_child(parent);
+
+        if(enter(child)) stack.push_back(Frame{.node = &child, .next_link = first_link(child), .started = false});
+    }
+}
+
+void Emitter::write_file(const fs::path& path) const {
+    int out = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if(out < 0){
+        throw std::runtime_error(ANNOT("Cannot open " + path.string() + ": " + std::strerror(errno)));
+    }
+
+    try {
+        write_all(out, buffer.data(), buffer.size(), path);
+
+    } catch (const std::runtime_error&) {
+        close(out);
+        throw;
+    }
+
+    close(out);
+}
+
+void Emitter::open_file(const fs::path& path){
+    close_file();
+
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if(fd < 0){
+        throw std::runtime_error(ANNOT("Cannot open " + path.string() + ": " + std::strerror(errno)));
+    }
+
+    file_path = path;
+    buffer.clear();
+}
+
+void Emitter::flush(){
+    write_all(fd, buffer.data(), buffer.size(), file_path);
+    buffer.clear();
+}
+
+void Emitter::close_file(){
+    if(fd < 0) return;
+
+    int out = fd;
+    fd = -1;
+
+    try {
+        write_all(out, buffer.data(), buffer.size(), file_path);
+
+    } catch (const std::runtime_error&) {
+        close(out);
+        throw;
+    }
+
+    close(out);
+    buffer.clear();
+}
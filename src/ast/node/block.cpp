@@ -1,57 +1,63 @@
 #include <block.h>
 
-std::shared_ptr<Resource::Qubit> Block::get_random_qubit(const U8& scope){
-    size_t total_qubits = qubits.get_num_of(scope);
-    
-    if(total_qubits){
-
-        #ifdef DEBUG
-        INFO("Getting random qubit");
-        #endif
+thread_local const std::shared_ptr<Resource::Qubit> Block::dummy_qubit = std::make_shared<Resource::Qubit>();
+thread_local const std::shared_ptr<Resource::Bit> Block::dummy_bit = std::make_shared<Resource::Bit>();
 
-        // std::cout << *this << std::endl;
+thread_local const std::shared_ptr<Qubit_definition> Block::dummy_qubit_def = std::make_shared<Qubit_definition>();
+thread_local const std::shared_ptr<Bit_definition> Block::dummy_bit_def = std::make_shared<Bit_definition>();
 
-        std::shared_ptr<Resource::Qubit> qubit = qubits.at(random_int(total_qubits - 1));
+std::shared_ptr<Resource::Qubit> Block::get_random_qubit(std::mt19937& rng, const U8& scope){
+    
+    if(free_qubits.count(scope) == 0) return dummy_qubit;
 
-        while(qubit->is_used() || !scope_matches(qubit->get_scope(), scope)){
-            qubit = qubits.at(random_int(total_qubits - 1));
-        }
+    #ifdef DEBUG
+    INFO("Getting random qubit");
+    #endif
 
-        qubit->set_used();
+    std::optional<uint32_t> index = free_qubits.draw(rng, scope);
 
-        return qubit;
-    
-    } else {
-        return dummy_qubit;
+    if(!index.has_value()){
+        throw std::runtime_error(ANNOT("Every qubit" + STR_SCOPE(scope) + " of block " + owner + " is already used by this gate"));
     }
+
+    return qubits.at(index.value());
 }
 
-std::shared_ptr<Resource::Bit> Block::get_random_bit(const U8& scope){
-    size_t total_bits = bits.get_num_of(scope);
-    
-    if(total_bits){
+std::shared_ptr<Resource::Bit> Block::get_random_bit(std::mt19937& rng, const U8& scope){
 
-        #ifdef DEBUG
-        INFO("Getting random bit");
-        #endif
+    if(free_bits.count(scope) == 0) return dummy_bit;
 
-        std::shared_ptr<Resource::Bit> bit = bits.at(random_int(total_bits - 1));
+    #ifdef DEBUG
+    INFO("Getting random bit");
+    #endif
 
-        while(bit->is_used() || !scope_matches(bit->get_scope(), scope)){
-            bit = bits.at(random_int(total_bits - 1));
-        }
+    std::optional<uint32_t> index = free_bits.draw(rng, scope);
 
-        bit->set_used();
+    if(!index.has_value()){
+        throw std::runtime_error(ANNOT("Every bit" + STR_SCOPE(scope) + " of block " + owner + " is already used by this gate"));
+    }
 
-        return bit;
-    
-    } else {
-        return dummy_bit;
+    return bits.at(index.value());
+}
+
+std::shared_ptr<Resource::Qubit> Block::take_qubit(size_t index){
+
+    if(!free_qubits.take(index)){
+        throw std::runtime_error(ANNOT("Qubit " + std::to_string(index) + " of block " + owner + " is already used by this gate, or doesn't exist"));
     }
+
+    return qubits.at(index);
+}
+
+void Block::refresh_free_lists(){
+    free_qubits.assign(qubits);
+    free_bits.assign(bits);
 }
 
 
 std::shared_ptr<Qubit_definition> Block::get_next_qubit_def(const U8& scope){
+    if(qubit_def_pointer >= qubit_defs.size()) return dummy_qubit_def;
+
     auto maybe_def = qubit_defs.at(qubit_def_pointer++);
 
     while((maybe_def != nullptr) && !scope_matches(maybe_def->get_scope(), scope)){
@@ -66,6 +72,8 @@ std::shared_ptr<Qubit_definition> Block::get_next_qubit_def(const U8& scope){
 }
 
 std::shared_ptr<Bit_definition> Block::get_next_bit_def(const U8& scope){
+    if(bit_def_pointer >= bit_defs.size()) return dummy_bit_def;
+
     auto maybe_def = bit_defs.at(bit_def_pointer++);
 
     while((maybe_def != nullptr) && !scope_matches(maybe_def->get_scope(), scope)){
@@ -80,16 +88,17 @@ std::shared_ptr<Bit_definition> Block::get_next_bit_def(const U8& scope){
 }
 
 /// @brief Make a register resource definition, whose size is bounded by `max_size`
+/// @param rng
 /// @param max_size 
 /// @param scope 
 /// @param classification 
 /// @param total_definitions 
 /// @return number of resources created from this definition
-unsigned int Block::make_register_resource_definition(unsigned int max_size, U8& scope, Resource::Classification classification, unsigned int& total_definitions){
+unsigned int Block::make_register_resource_definition(std::mt19937& rng, unsigned int max_size, U8& scope, Resource::Classification classification, unsigned int& total_definitions){
 
     unsigned int size;
 
-    if(max_size > 1) size = random_int(max_size, 1);
+    if(max_size > 1) size = random_int(rng, max_size, 1);
     else size = max_size;
 
     if (classification == Resource::QUBIT) {
@@ -148,7 +157,7 @@ unsigned int Block::make_singular_resource_definition(U8& scope, Resource::Class
     return 1;
 }
 
-unsigned int Block::make_resource_definitions(U8& scope, Resource::Classification classification){
+unsigned int Block::make_resource_definitions(std::mt19937& rng, U8& scope, Resource::Classification classification){
 
     unsigned int target_num_resources = 0, total_num_definitions = 0;
 
@@ -167,14 +176,16 @@ unsigned int Block::make_resource_definitions(U8& scope, Resource::Classificatio
         /*
             Use singular qubit or qubit register
         */
-        if(random_int(1)){
+        if(random_int(rng, 1)){
             target_num_resources -= make_singular_resource_definition(scope, classification, total_num_definitions);
 
         } else {
-            target_num_resources -= make_register_resource_definition(target_num_resources, scope, classification, total_num_definitions);
+            target_num_resources -= make_register_resource_definition(rng, target_num_resources, scope, classification, total_num_definitions);
         }
     }
 
+    refresh_free_lists();
+
     return total_num_definitions;
 }
 
@@ -184,59 +195,59 @@ unsigned int Block::make_resource_definitions(const Dag::Dag& dag, const U8& sco
         qubits = dag.get_qubits();
         qubit_defs = dag.get_qubit_defs();   
 
-        return qubit_defs.get_num_of(scope);
-
     } else {
         bits = dag.get_bits();
         bit_defs = dag.get_bit_defs();
-
-        return bit_defs.get_num_of(scope);
     }
+
+    refresh_free_lists();
+
+    return (classification == Resource::QUBIT) ? qubit_defs.get_num_of(scope) : bit_defs.get_num_of(scope);
 }
  
-void Block::print_info() const {
+void Block::print_info(std::ostream& stream) const {
 
-    std::cout << "=======================================" << std::endl;
-    std::cout << "              BLOCK INFO               " << std::endl;
-    std::cout << "=======================================" << std::endl;
-    std::cout << "Owner: " << owner << std::endl;
+    stream << "=======================================" << std::endl;
+    stream << "              BLOCK INFO               " << std::endl;
+    stream << "=======================================" << std::endl;
+    stream << "Owner: " << owner << std::endl;
 
-    std::cout << "Target num qubits " << std::endl;
-    std::cout << " EXTERNAL: " << target_num_qubits_external << std::endl;
-    std::cout << " INTERNAL: " << target_num_qubits_internal << std::endl;
+    stream << "Target num qubits " << std::endl;
+    stream << " EXTERNAL: " << target_num_qubits_external << std::endl;
+    stream << " INTERNAL: " << target_num_qubits_internal << std::endl;
 
-    std::cout << "Target num bits " << std::endl;
-    std::cout << " EXTERNAL: " << target_num_bits_external << std::endl;
-    std::cout << " INTERNAL: " << target_num_bits_internal << std::endl;
+    stream << "Target num bits " << std::endl;
+    stream << " EXTERNAL: " << target_num_bits_external << std::endl;
+    stream << " INTERNAL: " << target_num_bits_internal << std::endl;
 
-    std::cout << std::endl;
-    std::cout << "Qubit definitions " << std::endl;
+    stream << std::endl;
+    stream << "Qubit definitions " << std::endl;
 
     if(owner == Common::TOP_LEVEL_CIRCUIT_NAME){
-        std::cout << YELLOW("Qubit defs may not match target if block is built to match DAG") << std::endl;
+        stream << YELLOW("Qubit defs may not match target if block is built to match DAG") << std::endl;
     }
 
     for(const auto& qubit_def : qubit_defs){
-        std::cout << "name: " << qubit_def->get_name()->get_content() << " " ;
+        stream << "name: " << qubit_def->get_name()->get_content() << " " ;
 
         if(qubit_def->is_register_def()){
-            std::cout << "size: " << qubit_def->get_size()->get_content();
+            stream << "size: " << qubit_def->get_size()->get_content();
         }
 
-        std::cout << STR_SCOPE(qubit_def->get_scope()) << std::endl;
+        stream << STR_SCOPE(qubit_def->get_scope()) << std::endl;
     }
 
-    std::cout << "Bit definitions " << std::endl;
+    stream << "Bit definitions " << std::endl;
 
     for(const auto& bit_def : bit_defs){
-        std::cout << "name: " << bit_def->get_name()->get_content() << " " ;
+        stream << "name: " << bit_def->get_name()->get_content() << " " ;
 
         if(bit_def->is_register_def()){
-            std::cout << "size: " << bit_def->get_size()->get_content();
+            stream << "size: " << bit_def->get_size()->get_content();
         }
 
-        std::cout << STR_SCOPE(bit_def->get_scope()) << std::endl;
+        stream << STR_SCOPE(bit_def->get_scope()) << std::endl;
     }
 
-    std::cout << "=======================================" << std::endl;
+    stream << "=======================================" << std::endl;
 }
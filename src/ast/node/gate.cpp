@@ -15,9 +15,9 @@ Gate::Gate(const std::string& str, const Token::Kind& kind, const Collection<Qub
     assert(kind == Token::SUBROUTINE);
 
     // filter out external qubit defs
-    for(const auto& qubit_def : qubit_defs){
+    for(const std::shared_ptr<Qubit_definition>& qubit_def : qubit_defs.view()){
         if(qubit_def->get_scope() & EXTERNAL_SCOPE){
-            external_qubit_defs.add(*qubit_def);
+            external_qubit_defs.add(qubit_def);
             num_external_qubits += qubit_def->get_size()->get_num();
         }
     }
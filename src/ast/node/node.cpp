@@ -1,20 +1,22 @@
 #include <node.h>
+#include <emitter.h>
 
-int Node::node_counter = 0;
 
-#ifdef DEBUG
+void Node::print(std::ostream& stream) const {
+    Emitter emitter;
+    emitter.emit(*this);
+
+    stream << emitter.view();
+}
+
 std::string Node::get_debug_constraint_string() const {
-    if(constraint.has_value()){
+    if(!constraint.empty()){
         std::string debug_string;
 
-        for(size_t i = 0; i < constraint.value().size(); i++){
-            unsigned int n_occurances = constraint.value().get_occurances_at(i);
+        for(size_t i = 0; i < constraint.size(); i++){
+            unsigned int n_occurances = constraint.get_occurances_at(i);
             
-            debug_string += std::to_string(constraint.value().get_rule_kind_at(i)) + " with occurances: " + std::to_string(n_occurances) + " ";
-            
-            if(n_occurances > (unsigned int)WILDCARD_MAX){
-                debug_string += RED("(Cannot be satisfied! Max = " + std::to_string(WILDCARD_MAX) + ")");
-            }
+            debug_string += std::to_string(constraint.get_rule_kind_at(i)) + " with occurances: " + std::to_string(n_occurances) + " ";
         }
 
         return debug_string;
@@ -24,7 +26,6 @@ std::string Node::get_debug_constraint_string() const {
     
     }
 }
-#endif
 
 int Node::get_next_child_target(){
     size_t partition_size = child_partition.size();
@@ -57,9 +58,10 @@ int Node::get_next_child_target(){
 // }
 
 /// @brief Create a random partition of `target` over `n_children`. Final result contains +ve ints
+/// @param rng
 /// @param target 
 /// @param n_children 
-void Node::make_partition(int target, int n_children){
+void Node::make_partition(std::mt19937& rng, int target, int n_children){
 
     if((n_children == 1) || (target == 1)){
         child_partition = {target};
@@ -70,18 +72,23 @@ void Node::make_partition(int target, int n_children){
     } else {
 
         /*
-            make N-1 random cuts between 1 and T-1
+            make N-1 distinct random cuts between 1 and T-1, with Floyd's algorithm so that each cut takes one draw however many 
+            there are
             ex: 
                 T = 10, N = 4
                 {2, 9, 4}
         */
         std::vector<int> cuts;
+        std::unordered_set<int> taken;
+
+        cuts.reserve(n_children-1);
 
-        for(int i = 0; i < n_children-1; i++){
-            int val = random_int(target-1, 1);
+        for(int j = target - n_children + 1; j <= target-1; j++){
+            int val = random_int(rng, j, 1);
 
-            while(std::find(cuts.begin(), cuts.end(), val) != cuts.end()){
-                val = random_int(target-1, 1);
+            if(!taken.insert(val).second){
+                val = j;
+                taken.insert(val);
             }
 
             cuts.push_back(val);
@@ -121,16 +128,17 @@ void Node::make_partition(int target, int n_children){
 }
 
 /// @brief Make partitions for control flow blocks and branches, adding correct constraints where required
+/// @param rng
 /// @param target 
 /// @param n_children 
-void Node::make_control_flow_partition(int target, int n_children){
-    make_partition(target, n_children);
+void Node::make_control_flow_partition(std::mt19937& rng, int target, int n_children){
+    make_partition(rng, target, n_children);
     
     if(n_children == 1){
         add_constraint(Token::ELSE_STMT, 0);
         add_constraint(Token::ELIF_STMT, 0);
 
-    } else if (random_int(1)) {
+    } else if (random_int(rng, 1)) {
         add_constraint(Token::ELSE_STMT, 1);
         
     } else {
@@ -11,14 +11,12 @@ Qubit_op::Qubit_op(std::shared_ptr<Block> current_block):
     }
 }
 
-void Qubit_op::add_gate_if_subroutine(std::vector<std::shared_ptr<Node>>& subroutine_gates){
+void Qubit_op::add_gate_if_subroutine(std::vector<std::shared_ptr<Node>>& subroutine_gates, std::unordered_set<std::string>& subroutine_names){
     
     if(gate_node.has_value() && *gate_node.value() == Token::SUBROUTINE){
-        for(std::shared_ptr<Node>& gate : subroutine_gates){
-            if(gate->get_content() == gate_node.value()->get_content()){return;}
+        if(subroutine_names.insert(gate_node.value()->get_content()).second){
+            subroutine_gates.push_back(gate_node.value());
         }
-
-        subroutine_gates.push_back(gate_node.value());
     }
 }
 
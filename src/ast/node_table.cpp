@@ -0,0 +1,28 @@
+#include <node_table.h>
+#include <node.h>
+
+void Node_table::add_child(Node& parent, std::shared_ptr<Node> child){
+
+    if((parent.table != nullptr) && (parent.table != this)){
+        throw std::runtime_error(ANNOT("Node " + parent.get_content() + " already has children in another program"));
+    }
+
+    uint32_t link = children.size();
+
+    children.push_back(std::move(child));
+    next_links.push_back(NONE);
+
+    if(parent.table == nullptr){
+        parent.table = this;
+        parent.row = rows.size();
+
+        rows.push_back(Row{.first_link = link, .last_link = link, .n_children = 1});
+        return;
+    }
+
+    Row& row = rows[parent.row];
+
+    next_links[row.last_link] = link;
+    row.last_link = link;
+    row.n_children++;
+}
@@ -17,11 +17,10 @@ void Dag::Dag::make_dag(const std::shared_ptr<Block> block){
 }
 
 std::optional<unsigned int> Dag::Dag::nodewise_data_contains(std::shared_ptr<Qubit_op> node){
-    
-    for(unsigned int i = 0; i < nodewise_data.size(); i++){
-        if(nodewise_data[i].node->get_id() == node->get_id()){
-            return std::make_optional<unsigned int>(i);   
-        }
+    auto it = node_positions.find(node->get_id());
+
+    if(it != node_positions.end()){
+        return std::make_optional<unsigned int>(it->second);
     }
 
     return std::nullopt;
@@ -38,6 +37,7 @@ void Dag::Dag::add_edge(const Edge& edge, std::optional<int> maybe_dest_node_id,
 
     if(maybe_pos.has_value() == false){
         nodewise_data.push_back(Node_data{.node = source_node, .inputs = {}, .children = {}});
+        node_positions.emplace(source_node->get_id(), pos);
         
         // reserve memory for inputs depending on number of ports this gate has
         nodewise_data.at(pos).inputs.resize(source_node->get_n_ports(), 0);
@@ -45,12 +45,58 @@ void Dag::Dag::add_edge(const Edge& edge, std::optional<int> maybe_dest_node_id,
 
     if(maybe_dest_node_id.has_value()) nodewise_data.at(pos).children.push_back(maybe_dest_node_id.value());
 
+    // qubit ops don't know their gate's width, so ports past what was reserved are still possible
+    if(source_node_input_port >= nodewise_data.at(pos).inputs.size()){
+        nodewise_data.at(pos).inputs.resize(source_node_input_port + 1, 0);
+    }
+
     nodewise_data.at(pos).inputs[source_node_input_port] = qubit_id;
 
-    source_node->add_gate_if_subroutine(subroutine_gates);
+    source_node->add_gate_if_subroutine(subroutine_gates, subroutine_names);
+}
+
+/// @brief Same edges as `add_path_to_dag` would add, each one as soon as its destination is known. Qubit ops only count once some
+/// qubit they act on has more than one op on its path, as that is when `add_path_to_dag` first adds them
+void Dag::Dag::extend(const Resource::Qubit& qubit, const std::shared_ptr<Qubit_op>& node){
+    streamed = true;
+
+    // references into an unordered map stay valid while other elements are added
+    Open_node& current = open_nodes[node->get_id()];
+    current.node = node;
+    current.n_open_paths += 1;
+
+    auto add_to_dag = [&](Open_node& open){
+        if(!open.in_dag){
+            open.in_dag = true;
+            streamed_n_nodes += 1;
+            open.node->add_gate_if_subroutine(subroutine_gates, subroutine_names);
+        }
+    };
+
+    auto [it, first_op] = path_ends.try_emplace(&qubit, node->get_id());
+
+    if(!first_op){
+        int previous_id = it->second;
+        it->second = node->get_id();
+
+        Open_node& previous = open_nodes.at(previous_id);
+
+        previous.out_degree += 1;
+        current.depth = std::max(current.depth, previous.depth + 1);
+
+        add_to_dag(previous);
+        add_to_dag(current);
+
+        streamed_max_out_degree = std::max(streamed_max_out_degree, previous.out_degree);
+        streamed_depth = std::max(streamed_depth, current.depth);
+
+        if(--previous.n_open_paths == 0) open_nodes.erase(previous_id);
+    }
 }
 
-int Dag::Dag::max_out_degree(){
+int Dag::Dag::max_out_degree() const {
+    if(streamed) return streamed_max_out_degree;
+
     unsigned int curr_max = 0;
 
     for(const auto&data : nodewise_data){
@@ -60,13 +106,50 @@ int Dag::Dag::max_out_degree(){
     return curr_max;
 }
 
+/// @brief Longest path found by relaxing the children of each node once all its parents are done, so in time linear in the DAG
+/// @return 
+unsigned int Dag::Dag::depth() const {
+    if(streamed) return streamed_depth;
+
+    std::vector<unsigned int> n_parents(nodewise_data.size(), 0), longest(nodewise_data.size(), 1);
+    std::vector<unsigned int> ready;
+    unsigned int res = 0;
+
+    for(const auto& data : nodewise_data){
+        for(const unsigned int& child_id : data.children){
+            n_parents[node_positions.at(child_id)]++;
+        }
+    }
+
+    for(unsigned int i = 0; i < nodewise_data.size(); i++){
+        if(n_parents[i] == 0) ready.push_back(i);
+    }
+
+    while(ready.size()){
+        unsigned int pos = ready.back();
+        ready.pop_back();
+
+        res = std::max(res, longest[pos]);
+
+        for(const unsigned int& child_id : nodewise_data[pos].children){
+            unsigned int child = node_positions.at(child_id);
+
+            longest[child] = std::max(longest[child], longest[pos] + 1);
+
+            if(--n_parents[child] == 0) ready.push_back(child);
+        }
+    }
+
+    return res;
+}
+
 /// @brief Combine heuristics to get dag score
 /// @return 
-int Dag::Dag::score(){   
+int Dag::Dag::score() const {   
     return max_out_degree();
 }
 
-void Dag::Dag::render_dag(const fs::path& current_circuit_dir){
+void Dag::Dag::render_dag(const fs::path& current_circuit_dir, bool verbose){
     std::ostringstream dot_string;
 
     dot_string << "digraph G {\n";
@@ -83,6 +166,6 @@ void Dag::Dag::render_dag(const fs::path& current_circuit_dir){
     const std::string str = dag_render_path.string();
     std::string command = "dot -Tpng -o " + str;
     
-    pipe_to_command(command, dot_string.str());
+    pipe_to_command(command, dot_string.str(), verbose);
     INFO("Program DAG rendered to " + YELLOW(dag_render_path.string()));
 }
\ No newline at end of file
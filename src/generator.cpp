@@ -1,10 +1,25 @@
 #include <generator.h>
+#include <emitter.h>
 
 /// @brief TODO: make it such that user can call entry point with particular scope
 /// @param entry_name 
 void Generator::setup_builder(const std::string& entry_name, const U8& scope){
-    if(grammar->is_rule(entry_name, scope)){
-        builder->set_entry(grammar->get_rule_pointer_if_exists(entry_name, scope));
+    // the entry has to be defined with exactly the scope asked for
+    std::optional<Ir::Index> entry = grammar->find_exact_rule(entry_name, scope);
+
+    if(entry.has_value()){
+        builder->set_entry(grammar, entry.value());
+
+        // weights carried over from before a reload only apply once there is an entry, after which setting them again changes nothing
+        std::lock_guard<std::mutex> lock(weights_mutex);
+
+        std::erase_if(weights, [&](const Weight& weight){
+            if(apply_weight(weight, false)) return false;
+
+            WARNING("Rule " + weight.rule_name + " no longer has branch " + std::to_string(weight.branch) + " in " + grammar->get_name() + 
+                ", dropped its weight");
+            return true;
+        });
 
     } else if(builder->entry_set()){
         WARNING("Rule " + entry_name + STR_SCOPE(scope) + " is not defined for grammar " + grammar->get_name() + ". Will use previous entry instead");
@@ -14,49 +29,158 @@ void Generator::setup_builder(const std::string& entry_name, const U8& scope){
     }
 }
 
-void Generator::ast_to_program(fs::path output_dir, int build_counter, std::optional<Genome> genome){
+void Generator::set_weight(const std::string& rule_name, unsigned int branch, float weight){
+
+    if(!builder->entry_set()){
+        ERROR("Set an entry for " + grammar->get_name() + " before weighting its branches");
+        return;
+    }
+
+    if(!std::isfinite(weight) || (weight < 0.0f)){
+        ERROR("Branch weights must be finite and not negative");
+        return;
+    }
+
+    Weight setting{.rule_name = rule_name, .branch = branch, .weight = weight};
+
+    std::lock_guard<std::mutex> lock(weights_mutex);
+
+    if(apply_weight(setting, true)){
+        INFO("Branch " + std::to_string(branch) + " of " + rule_name + " now has weight " + std::to_string(weight));
+
+        std::erase_if(weights, [&](const Weight& w){return (w.rule_name == rule_name) && (w.branch == branch);});
+        weights.push_back(setting);
+    }
+}
+
+bool Generator::apply_weight(const Weight& weight, bool report){
+    bool defined = false, found = false;
+
+    for(Ir::Index r = 0; r < grammar->get_tables().rules.size(); r++){
+        if(grammar->rule_name(r) != weight.rule_name) continue;
+
+        defined = true;
+
+        if(weight.branch < grammar->rule(r).n_branches){
+            builder->set_weight(r, weight.branch, weight.weight);
+            found = true;
+
+        } else if(report){
+            WARNING("Rule " + weight.rule_name + STR_SCOPE(grammar->rule(r).scope) + " has no branch " + std::to_string(weight.branch));
+        }
+    }
+
+    if(report && !defined){
+        ERROR("Rule " + weight.rule_name + " is not defined for grammar " + grammar->get_name());
+    }
+
+    return found;
+}
+
+void Generator::ast_to_program(fs::path output_dir, int build_counter, std::optional<Genome>&& genome, const Common::Flags& flags){
+    ast_to_program(*builder, output_dir / ("circuit" + std::to_string(build_counter)), build_counter, std::move(genome), std::nullopt, flags);
+}
+
+void Generator::replay(fs::path circuit_dir, int build_counter, U64 seed, const Common::Flags& flags){
+    ast_to_program(*builder, circuit_dir, build_counter, std::nullopt, seed, flags);
+}
+
+void Generator::ast_to_program(Ast& ast, fs::path current_circuit_dir, int build_counter, std::optional<Genome>&& genome, std::optional<U64> seed, const Common::Flags& flags){
+
+    // the genome is moved into the build, only its score is needed after
+    bool from_genome = genome.has_value();
+    int genome_score = from_genome ? genome.value().dag_score : 0;
 
-    fs::path current_circuit_dir =  output_dir / ("circuit" + std::to_string(build_counter));
     fs::create_directory(current_circuit_dir);
 
-    builder->set_ast_counter(build_counter);
+    ast.set_ast_counter(build_counter);
+
+    // every random choice below, the swarm testing gateset included, follows from the seed
+    if(seed.has_value()) ast.seed(seed.value());
+
+    ast.set_size_target(from_genome ? std::nullopt : flags.size_target);
 
     std::optional<Node_constraint> gateset;
 
-    if (Common::swarm_testing) {
-        gateset = get_swarm_testing_gateset();
+    if (flags.swarm_testing) {
+        gateset = get_swarm_testing_gateset(ast.rng());
     } else {
         gateset = std::nullopt;
     }
-    Result<Node> maybe_ast_root = builder->build(genome, gateset);
 
-    if(maybe_ast_root.is_ok()){
-        Node ast_root = maybe_ast_root.get_ok();
+    fs::path program_path = current_circuit_dir / "circuit.py";
+
+    // each thread keeps reusing its own buffer
+    thread_local Emitter emitter;
 
-        fs::path program_path = current_circuit_dir / "circuit.py";
-        std::ofstream stream(program_path.string());
+    // programs from a genome are rebuilt from its DAG, and rendering wants the whole tree, so only plain random ones are streamed
+    bool streaming = flags.streaming && !from_genome && !flags.render_dags;
+
+    if(streaming) emitter.open_file(program_path);
+
+    std::ostringstream report;
+    Result<Program> maybe_program = ast.build(std::move(genome), gateset, report, streaming ? &emitter : nullptr);
+
+    if(maybe_program.is_ok()){
+        Program program = maybe_program.take_ok();
 
         // render dag (main block)
-        if (Common::render_dags) {
-            builder->render_dag(current_circuit_dir);
+        if (flags.render_dags) {
+            program.render_dag(current_circuit_dir, flags.verbose);
         }
 
         int dag_score;
 
-        if(genome.has_value()){
-            dag_score = genome.value().dag_score;
+        if(from_genome){
+            dag_score = genome_score;
         } else {
-            dag_score = builder->genome().dag_score;
+            dag_score = program.get_dag().score();
         }
 
+        // write program
+        if(streaming){
+            emitter.append("\n");
+            emitter.close_file();
+
+        } else {
+            emitter.clear();
+            emitter.emit(program.get_root());
+            emitter.append("\n");
+            emitter.write_file(program_path);
+        }
+
+        if(seed.has_value()){
+            std::ofstream(current_circuit_dir / "seed.txt") << seed.value() << std::endl;
+        }
+
+        // everything about one program is printed together, whichever thread built it
+        std::lock_guard<std::mutex> lock(output_mutex);
+
+        std::cout << report.str();
         INFO("Dag score: " + std::to_string(dag_score));
 
-        // write program
-        stream << ast_root << std::endl;
+        if(flags.size_target.has_value() && !from_genome){
+            const Dag::Dag& dag = program.get_dag();
+            std::string size = std::to_string(dag.n_qubit_ops()) + " qubit ops, depth " + std::to_string(dag.depth());
+
+            if((dag.n_qubit_ops() != flags.size_target->n_qubit_ops) || (dag.depth() < flags.size_target->min_depth)){
+                WARNING("Size target missed, main circuit has " + size);
+            } else {
+                INFO("Main circuit has " + size);
+            }
+        }
         INFO("Program written to " + YELLOW(program_path.string()));
         
     } else {
-        ERROR(maybe_ast_root.get_error());
+        if(streaming){
+            emitter.close_file();
+            fs::remove(program_path);
+        }
+
+        std::lock_guard<std::mutex> lock(output_mutex);
+
+        std::cout << report.str();
+        ERROR(maybe_program.get_error());
     }
 }
 
@@ -75,7 +199,7 @@ std::pair<Genome&, Genome&> Generator::pick_parents(){
         }
 
         std::discrete_distribution<> dist(weights.begin(), weights.end());
-        return indices[dist(seed())];
+        return indices[dist(builder->rng())];
     };
 
     size_t first, second;
@@ -94,19 +218,22 @@ std::pair<Genome&, Genome&> Generator::pick_parents(){
 std::vector<Token::Kind> Generator::get_available_gates(){
     std::vector<Token::Kind> out;
 
-    std::shared_ptr<Rule> gate_name = grammar->get_rule_pointer_if_exists("gate_name");
+    std::optional<Ir::Index> gate_name = grammar->find_rule("gate_name");
     
-    if(gate_name == nullptr){
+    if(!gate_name.has_value()){
         ERROR("No gates have been defined in the grammar!");
 
     } else {
+        const Ir::Rule& rule = grammar->rule(gate_name.value());
 
-        for (const Branch& b : gate_name->get_branches()) {
-            std::vector<Term> terms = b.get_terms();
+        for (Ir::Index b = rule.first_branch; b < rule.first_branch + rule.n_branches; b++) {
+            const Ir::Branch& branch = grammar->branch(b);
 
-            for (const Term& t : terms) {
-                if ((t.get_kind() != Token::MEASURE) && (t.get_kind() != Token::MEASURE_AND_RESET)) {
-                    out.push_back(t.get_kind());
+            for (Ir::Index t = branch.first_term; t < branch.first_term + branch.n_terms; t++) {
+                const Ir::Term& term = grammar->term(t);
+
+                if ((term.kind != Token::MEASURE) && (term.kind != Token::MEASURE_AND_RESET)) {
+                    out.push_back(term.kind);
                 }
             }
         }
@@ -115,7 +242,7 @@ std::vector<Token::Kind> Generator::get_available_gates(){
     return out;
 }
 
-Node_constraint Generator::get_swarm_testing_gateset(){
+Node_constraint Generator::get_swarm_testing_gateset(std::mt19937& rng){
     std::vector<Token::Kind> gates = get_available_gates();
 
     size_t n_gates = std::min((size_t)Common::SWARM_TESTING_GATESET_SIZE, gates.size());
@@ -128,7 +255,7 @@ Node_constraint Generator::get_swarm_testing_gateset(){
     }
     #endif
 
-    std::sample(gates.begin(), gates.end(), selected_gates.begin(), n_gates, seed());
+    std::sample(gates.begin(), gates.end(), selected_gates.begin(), n_gates, rng);
 
     /*
         Gateset needs to be unique, there are probably many ways to do this but this is just what I've done
@@ -152,10 +279,14 @@ Dag::Dag Generator::crossover(const Dag::Dag& dag1, const Dag::Dag& dag2){
 /// @brief Use genetic algorithm to maximize DAG score, producing final set of circuits that maximise this score
 /// @param output_dir 
 /// @param population_size 
-void Generator::run_genetic(fs::path output_dir, int population_size){
+/// @param master_seed
+/// @param flags
+void Generator::run_genetic(fs::path output_dir, int population_size, U64 master_seed, const Common::Flags& flags){
 
     if(!population_size) return;
 
+    builder->seed(master_seed);
+
     /*
         Fill initial DAG population
     */
@@ -165,15 +296,15 @@ void Generator::run_genetic(fs::path output_dir, int population_size){
 
         std::optional<Node_constraint> gateset;
 
-        if (Common::swarm_testing) {
-            gateset = get_swarm_testing_gateset();
+        if (flags.swarm_testing) {
+            gateset = get_swarm_testing_gateset(builder->rng());
         } else {
             gateset = std::nullopt;
         }
-        Result<Node> maybe_root = builder->build(std::nullopt, gateset);
+        Result<Program> maybe_program = builder->build(std::nullopt, gateset);
 
-        if(maybe_root.is_ok()){
-            population.push_back(builder->genome());
+        if(maybe_program.is_ok()){
+            population.push_back(maybe_program.take_ok().take_genome());
         }
     }
 
@@ -196,21 +327,23 @@ void Generator::run_genetic(fs::path output_dir, int population_size){
         */
         std::vector<Genome> new_pop;
 
+        // children first, since any of the population can be a parent, top performers included
         for(int j = 0; j < population_size; j++){
-
-            // top performers go to next epoch as is, already in population in correct order due to sort 
             if(j > elitism * population_size){
                 std::pair<Genome&, Genome&> parents = pick_parents();
 
-                Genome child{.dag = std::move(crossover(parents.first.dag, parents.second.dag)), .dag_score = 0};
+                Genome child{.dag = crossover(parents.first.dag, parents.second.dag), .dag_score = 0};
                 child.dag_score = child.dag.score();
 
-                new_pop.push_back(child);
-            } else {
-                new_pop.push_back(population[j]);
+                new_pop.push_back(std::move(child));
             }
         }
 
+        // top performers go to next epoch as is, already in population in correct order due to sort, and nothing reads them after this
+        for(int j = 0; (j <= elitism * population_size) && (j < (int)population.size()); j++){
+            new_pop.push_back(std::move(population[j]));
+        }
+
         population = std::move(new_pop);
     }
 
@@ -220,15 +353,65 @@ void Generator::run_genetic(fs::path output_dir, int population_size){
         Generate programs from final DAGs
     */
     for(int build_counter = 0; build_counter < (int)population.size(); build_counter++){
-        ast_to_program(output_dir, build_counter, std::make_optional<Genome>(population[build_counter]));
+        // each genome is built once, so its DAG is handed over rather than copied
+        ast_to_program(output_dir, build_counter, std::move(population[build_counter]), flags);
     }
 
     INFO(YELLOW("Generated " + std::to_string(population_size) + " program(s)"));
 
 }
 
-void Generator::generate_random_programs(fs::path output_dir, int n_programs){
-    for(int build_counter = 0; build_counter < n_programs; build_counter++){
-        ast_to_program(output_dir, build_counter, std::nullopt);
+/// @brief Build programs over a pool of threads, each with a builder of its own over the shared grammar. Program `i` is always
+/// written to `circuiti`, and built from the seed split off `master_seed` at `first_program + i`, whichever thread builds it
+/// @param output_dir 
+/// @param n_programs 
+/// @param master_seed 
+/// @param first_program number of programs generated from the master seed before these
+/// @param flags 
+void Generator::generate_random_programs(fs::path output_dir, int n_programs, U64 master_seed, U64 first_program, const Common::Flags& flags){
+
+    if(n_programs <= 0) return;
+
+    unsigned int n_threads = flags.n_threads ? flags.n_threads : std::max(1U, std::thread::hardware_concurrency());
+    size_t n_workers = std::min<size_t>(n_programs, n_threads);
+
+    if(n_workers == 1){
+        for(int build_counter = 0; build_counter < n_programs; build_counter++){
+            try{
+                U64 seed = split_seed(master_seed, first_program + build_counter);
+                ast_to_program(*builder, output_dir / ("circuit" + std::to_string(build_counter)), build_counter, std::nullopt, seed, flags);
+
+            } catch (const std::exception& error) {
+                ERROR("Could not write circuit" + std::to_string(build_counter) + ": " + error.what());
+            }
+        }
+
+        return;
+    }
+
+    /*
+        programs take very different times to build, so rather than splitting them up front each worker takes the next index 
+        as soon as it's free
+    */
+    std::atomic<int> next = 0;
+    std::vector<std::thread> workers;
+
+    for(size_t w = 0; w < n_workers; w++){
+        workers.emplace_back([&, ast = builder->fork()](){
+            for(int build_counter = next++; build_counter < n_programs; build_counter = next++){
+                try{
+                    U64 seed = split_seed(master_seed, first_program + build_counter);
+                    ast_to_program(*ast, output_dir / ("circuit" + std::to_string(build_counter)), build_counter, std::nullopt, seed, flags);
+
+                } catch (const std::exception& error) {
+                    std::lock_guard<std::mutex> lock(output_mutex);
+                    ERROR("Could not write circuit" + std::to_string(build_counter) + ": " + error.what());
+                }
+            }
+        });
+    }
+
+    for(auto& worker : workers){
+        worker.join();
     }
 }
\ No newline at end of file
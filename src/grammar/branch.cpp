@@ -2,20 +2,19 @@
 
 void Branch::add(const Term& term){
     terms.push_back(term);
+
+    if(term.is_repetition()){
+        n_repetitions += 1 + term.get_group()->num_repetitions();
+    }
 }
 
-/// @brief Given the current branch and the nesting depth, work out which terms within a branch should be multiplied. The term's grouping scope tells you that, which is 
-/// infered by comparing with the nesting depth. Terms with a nesting depth strictly greater than it are multiplied, the rest are left alone. This split is stored inside the 
-/// `Branch_multiply` struct.
-/// @param basis 
-/// @param nesting_depth 
-void Branch::setup_basis(Branch_multiply& basis, unsigned int nesting_depth) const {
+Term Branch::take_last(){
+    Term term = terms.back();
+    terms.pop_back();
 
-    for(const Term& t : terms){
-        if(t.get_branch_nesting_depth() > nesting_depth){  // only multiply the term if it is in the correct grouping scope
-            basis.mults.push_back(t);
-        } else {
-            basis.remainders.push_back(t);
-        }
+    if(term.is_repetition()){
+        n_repetitions -= 1 + term.get_group()->num_repetitions();
     }
+
+    return term;
 }
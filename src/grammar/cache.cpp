@@ -0,0 +1,159 @@
+#include <cache.h>
+
+#include <fstream>
+#include <cstring>
+#include <unistd.h>
+
+namespace Cache {
+
+    /*
+        every token kind's name and number, so that a cache written before the kinds were renumbered has a different key
+    */
+    constexpr U64 KINDS_HASH = []{
+        U64 hash = 14695981039346656037ULL;
+
+        for(const auto& [name, kind] : Token::KIND_NAMES){
+            for(const char& c : name){
+                hash ^= static_cast<uint8_t>(c);
+                hash *= 1099511628211ULL;
+            }
+
+            hash ^= static_cast<U64>(kind);
+            hash *= 1099511628211ULL;
+        }
+
+        return hash;
+    }();
+
+    U64 key(const fs::path& grammar_path, U64 meta_grammar_hash){
+        return hash_file(grammar_path, (((meta_grammar_hash ^ VERSION) * 1099511628211ULL) ^ KINDS_HASH) * 1099511628211ULL);
+    }
+
+    /// @brief Read `n` records straight into `out`
+    template<typename T>
+    static bool read_table(std::istream& stream, uint32_t n, std::vector<T>& out){
+        out.resize(n);
+        return (bool)stream.read(reinterpret_cast<char*>(out.data()), (std::streamsize)n * sizeof(T));
+    }
+
+    /// @brief Read the image of a grammar from `stream`, which holds `size` bytes. Nothing if the image was written for a different key,
+    /// or is damaged, which is warned about as `what`
+    static std::optional<Ir::Grammar> read(std::istream& stream, U64 size, const fs::path& grammar_path, U64 key, const std::string& what){
+        Header header;
+
+        if(!stream.read(reinterpret_cast<char*>(&header), sizeof(Header)) || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) || 
+            (header.version != VERSION) || (header.key != key)
+        ){
+            return std::nullopt;
+        }
+
+        // checked before anything is allocated, so a damaged header can't ask for more than the image holds
+        U64 expected_size = sizeof(Header) + 
+            (U64)header.n_rules * sizeof(Ir::Rule) + 
+            (U64)header.n_branches * sizeof(Ir::Branch) + 
+            (U64)header.n_terms * sizeof(Ir::Term) + 
+            (U64)header.n_kind_counts * sizeof(Ir::Kind_count) + 
+            (U64)header.n_repeated_kinds * sizeof(Ir::Kind_count) + 
+            (U64)header.n_strings * sizeof(Ir::String) + 
+            header.n_arena_bytes;
+
+        if(size != expected_size){
+            WARNING(what + " is truncated");
+            return std::nullopt;
+        }
+
+        Ir::Tables tables;
+        tables.arena.resize(header.n_arena_bytes);
+
+        bool complete = 
+            read_table(stream, header.n_rules, tables.rules) &&
+            read_table(stream, header.n_branches, tables.branches) &&
+            read_table(stream, header.n_terms, tables.terms) &&
+            read_table(stream, header.n_kind_counts, tables.kind_counts) &&
+            read_table(stream, header.n_repeated_kinds, tables.repeated_kinds) &&
+            read_table(stream, header.n_strings, tables.strings) &&
+            stream.read(tables.arena.data(), tables.arena.size());
+
+        if(!complete){
+            WARNING(what + " is truncated");
+            return std::nullopt;
+        }
+
+        Ir::Grammar grammar(grammar_path, std::move(tables));
+
+        if(!grammar.valid()){
+            WARNING(what + " is corrupted");
+            return std::nullopt;
+        }
+
+        return grammar;
+    }
+
+    std::optional<Ir::Grammar> load(const fs::path& grammar_path, const fs::path& cache_path, U64 key){
+        std::ifstream stream(cache_path, std::ios::in | std::ios::binary);
+        std::error_code error;
+        U64 size = fs::file_size(cache_path, error);
+
+        if(!stream || error) return std::nullopt;
+
+        return read(stream, size, grammar_path, key, "Grammar cache " + cache_path.string());
+    }
+
+    template<typename T>
+    static void write_table(std::ostream& stream, const std::vector<T>& table){
+        stream.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(T));
+    }
+
+    static void write(const Ir::Grammar& grammar, U64 key, std::ostream& stream){
+        const Ir::Tables& tables = grammar.get_tables();
+
+        Header header{
+            .magic = {MAGIC[0], MAGIC[1], MAGIC[2], MAGIC[3]},
+            .version = VERSION,
+            .key = key,
+            .n_rules = (uint32_t)tables.rules.size(),
+            .n_branches = (uint32_t)tables.branches.size(),
+            .n_terms = (uint32_t)tables.terms.size(),
+            .n_kind_counts = (uint32_t)tables.kind_counts.size(),
+            .n_repeated_kinds = (uint32_t)tables.repeated_kinds.size(),
+            .n_strings = (uint32_t)tables.strings.size(),
+            .n_arena_bytes = (uint32_t)tables.arena.size()
+        };
+
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        write_table(stream, tables.rules);
+        write_table(stream, tables.branches);
+        write_table(stream, tables.terms);
+        write_table(stream, tables.kind_counts);
+        write_table(stream, tables.repeated_kinds);
+        write_table(stream, tables.strings);
+        stream.write(tables.arena.data(), tables.arena.size());
+    }
+
+    void save(const Ir::Grammar& grammar, const fs::path& cache_path, U64 key){
+        /*
+            write to a temporary file and rename it over the old cache, so that fuzzers starting at the same time never read a half written file
+        */
+        std::error_code error;
+        fs::create_directories(cache_path.parent_path(), error);
+
+        fs::path tmp_path = cache_path;
+        tmp_path += ".tmp" + std::to_string(getpid());
+
+        std::ofstream stream(tmp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+
+        write(grammar, key, stream);
+        stream.close();
+
+        if(stream.fail()){
+            WARNING("Could not write grammar cache " + tmp_path.string());
+            fs::remove(tmp_path, error);
+
+        } else {
+            fs::rename(tmp_path, cache_path, error);
+
+            if(error) WARNING("Could not write grammar cache " + cache_path.string() + ": " + error.message());
+        }
+    }
+
+}
@@ -1,8 +1,13 @@
 #include <grammar.h>
 
-Grammar::Grammar(const fs::path& filename, std::vector<Token::Token>& meta_grammar_tokens): lexer(filename.string()), name(filename.stem()), path(filename) {
+Grammar::Grammar(const fs::path& filename, std::shared_ptr<const Grammar> _base): base(_base), name(filename.stem()), path(filename) {
+    Lexer::Lexer lexer(filename.string());
 
-    tokens = append_vectors(meta_grammar_tokens, lexer.get_tokens());
+    tokens = std::move(lexer.get_tokens());
+
+    if(base != nullptr){
+        rule_pointers = base->get_rules();
+    }
 
     num_tokens = tokens.size();
 
@@ -39,25 +44,79 @@ void Grammar::peek(){
 
 }
 
-std::shared_ptr<Rule> Grammar::get_rule_pointer_if_exists(const std::string& name, const U8& scope){
+std::shared_ptr<Rule> Grammar::find_rule(const std::string& name, const U8& scope, bool& shared) const {
+    shared = false;
+
+    // base rules were added first, so they win any slot they match
+    if(base != nullptr){
+        std::shared_ptr<Rule> rule = base->get_rule_pointer_if_exists(name, scope);
 
-    for(const auto& rp : rule_pointers){
-        if(rp->matches(name, scope)){return rp;}
+        if(rule != nullptr){
+            auto it = shadows.find(rule.get());
+
+            if(it != shadows.end()){
+                return it->second;
+            }
+
+            shared = true;
+            return rule;
+        }
     }
 
-    return nullptr;
+    auto it = rule_index.find(name);
+
+    if(it == rule_index.end()){
+        return nullptr;
+    } else {
+        return it->second[scope & ALL_SCOPES];
+    }
+}
+
+std::shared_ptr<Rule> Grammar::get_rule_pointer_if_exists(const std::string& name, const U8& scope) const {
+    bool shared;
+    return find_rule(name, scope, shared);
 }
 
 std::shared_ptr<Rule> Grammar::get_rule_pointer(const Token::Token& token, const U8& scope){
-    auto dummy = std::make_shared<Rule>(token, scope);
+    std::shared_ptr<Rule> rule = get_rule_pointer_if_exists(token.value, scope);
+
+    if(rule == nullptr){
+        rule = std::make_shared<Rule>(token, scope);
 
-    for(const auto& rp : rule_pointers){
-        if(*rp == *dummy){return rp;}
+        add_rule(rule);
     }
 
-    rule_pointers.push_back(dummy);
+    return rule;
+}
+
+std::shared_ptr<Rule> Grammar::get_rule_to_define(const Token::Token& token, const U8& scope){
+    bool shared;
+    std::shared_ptr<Rule> rule = find_rule(token.value, scope, shared);
+
+    if(rule == nullptr){
+        rule = std::make_shared<Rule>(token, scope);
+        add_rule(rule);
+
+    } else if(shared){
+        std::shared_ptr<Rule> shadow = std::make_shared<Rule>(*rule);
 
-    return dummy;
+        *std::find(rule_pointers.begin(), rule_pointers.end(), rule) = shadow;
+        shadows[rule.get()] = shadow;
+
+        rule = shadow;
+    }
+
+    return rule;
+}
+
+void Grammar::index_rule(const std::shared_ptr<Rule>& rule){
+    auto& slots = rule_index[rule->get_name()];
+
+    for(U8 scope = NO_SCOPE; scope <= ALL_SCOPES; scope++){
+        if((slots[scope] == nullptr) && scope_matches(rule->get_scope(), scope)){
+            slots[scope] = rule;
+        }
+    }
 }
 
 /// @brief Convert a single token into a term and add it to the given branch
@@ -65,7 +124,7 @@ std::shared_ptr<Rule> Grammar::get_rule_pointer(const Token::Token& token, const
 void Grammar::add_term_to_branch(const Token::Token& token, Branch& branch){
     
     if(token.kind == Token::SYNTAX){
-        branch.add(Term(token.value, token.kind, nesting_depth));
+        branch.add(Term(token.value, token.kind));
 
     } else if (is_kind_of_rule(token.kind)){
         /*
@@ -75,71 +134,113 @@ void Grammar::add_term_to_branch(const Token::Token& token, Branch& branch){
         */
         U8 scope = (rule_decl_scope == NO_SCOPE) && (current_rule != nullptr) ? current_rule->get_scope() : rule_decl_scope;
 
-        branch.add(Term(get_rule_pointer(token, scope), token.kind, nesting_depth));
+        branch.add(Term(get_rule_pointer(token, scope), token.kind));
     
     } else {
         throw std::runtime_error(ANNOT("Build branch should only be called on syntax or rule tokens!"));
     }
 
+    // recursion is a property of the whole branch, even when the term sits inside a group
     if((current_rule != nullptr) && (token.value == current_rule->get_name()) && is_kind_of_rule(token.kind)){
-        branch.set_recursive_flag();
+        current_branch.set_recursive_flag();
     }
 }
 
-/// @brief The token into a term and add it to all current branches
-/// @param tokens 
-void Grammar::add_term_to_current_branches(const Token::Token& token){
-    if(current_branches.size() == 0){
-        Branch b;
+void Grammar::complete_branch(){
+    if(!open_groups.empty()){
+        throw std::runtime_error(ANNOT("Unclosed group in rule " + current_rule->get_name()));
+    }
+
+    current_rule->add(current_branch);
+    current_branch = Branch();
+}
+
+/// @brief A group followed by a wildcard is kept whole to become a repetition, any other group is just spliced into the enclosing sequence
+void Grammar::close_group(){
+    if(open_groups.empty()){
+        throw std::runtime_error(ANNOT("Unbalanced ) in rule " + current_rule->get_name()));
+    }
+
+    Branch group = std::move(open_groups.back());
+    open_groups.pop_back();
+
+    if(Token::is_wildcard(next_token.get_ok().kind)){
+        closed_group = std::move(group);
 
-        add_term_to_branch(token, b);
-        current_branches.push_back(b);
- 
     } else {
-        for(Branch& current_branch : current_branches){
-            add_term_to_branch(token, current_branch);
+        for(const Term& term : group){
+            current_sequence().add(term);
         }
     }
 }
 
-void Grammar::extend_current_branches(const Token::Token& wildcard){
-    // loop through current heads, and multiply
-    std::vector<Branch> extensions;
-    Branch_multiply basis;
+/// @brief Wrap the group just closed, or the last term if there is no group, into a repetition with the bounds given by the wildcard
+/// @param wildcard 
+void Grammar::add_repetition(const Token::Token& wildcard){
+    unsigned int min_repetitions = 0;
+    std::optional<unsigned int> max_repetitions = std::nullopt;
 
-    for(const Branch& current_branch : current_branches){
-        if(!current_branch.is_empty()){
-            basis.clear();
-            current_branch.setup_basis(basis, nesting_depth);
+    if(wildcard.kind == Token::OPTIONAL){
+        max_repetitions = 1;
 
-            if(wildcard.kind == Token::OPTIONAL){
-                extensions.push_back(Branch(basis.remainders));
-                break;            
+    } else if(wildcard.kind == Token::ONE_OR_MORE){
+        min_repetitions = 1;
 
-            } else if (wildcard.kind == Token::ZERO_OR_MORE){
-                extensions.push_back(Branch(basis.remainders));
-            }
-        
-            // use basis to get extensions depending on the wildcard being processed
-            for(unsigned int mult = 2; mult <= WILDCARD_MAX; ++mult){
+    } else if(wildcard.kind == Token::RANGE){
+        size_t comma = wildcard.value.find(',');
 
-                auto terms = append_vectors(basis.remainders, multiply_vector(basis.mults, mult));
-                
-                Branch extension(terms);
-                extensions.push_back(extension);
-            }
+        if(comma == std::string::npos){
+            min_repetitions = std::stoul(wildcard.value);
+            max_repetitions = min_repetitions;
+
+        } else {
+            if(comma > 0) min_repetitions = std::stoul(wildcard.value.substr(0, comma));
 
+            if(comma + 1 < wildcard.value.size()) max_repetitions = std::stoul(wildcard.value.substr(comma + 1));
         }
+
+        if(max_repetitions.has_value() && (min_repetitions > max_repetitions.value())){
+            throw std::runtime_error(ANNOT("Empty repetition range {" + wildcard.value + "} in rule " + current_rule->get_name()));
+        }
+    }
+
+    Branch group;
+
+    if(closed_group.has_value()){
+        group = std::move(closed_group.value());
+        closed_group.reset();
+
+    } else if(!current_sequence().is_empty()){
+        group.add(current_sequence().take_last());
+
+    } else {
+        throw std::runtime_error(ANNOT("Nothing to repeat before " + wildcard.value + " in rule " + current_rule->get_name()));
+    }
+
+    current_sequence().add(Term(std::make_shared<const Branch>(std::move(group)), wildcard.kind, min_repetitions, max_repetitions));
+}
+
+/// @brief Weight the branch being built, i.e `h @3 | x`
+/// @param weight 
+void Grammar::set_weight(const Token::Token& weight){
+    if((current_rule == nullptr) || !open_groups.empty()){
+        throw std::runtime_error(ANNOT("Weight @" + weight.value + " must follow a whole branch of a rule"));
     }
 
-    increment_nesting_depth_base(); // must be done after wildcards are processed
+    float value;
 
-    current_branches.insert(current_branches.end(), extensions.begin(), extensions.end());
+    try{
+        value = std::stof(weight.value);
+    } catch (const std::exception&) {
+        throw std::runtime_error(ANNOT("Bad weight @" + weight.value + " in rule " + current_rule->get_name()));
+    }
+
+    current_branch.set_weight(value);
 }
 
 void Grammar::build_grammar(){
 
-    if(curr_token.is_ok()){
+    while(curr_token.is_ok()){
         Token::Token token = curr_token.get_ok();
 
         // cannot set here because if curr token is EOF, next should be an error. 
@@ -156,40 +257,40 @@ void Grammar::build_grammar(){
 
             // rules that are within branches, rules before `RULE_START` are handled at `RULE_START`
             if(current_rule != nullptr){
-                add_term_to_current_branches(token);
+                add_term_to_branch(token, current_sequence());
                 rule_decl_scope = NO_SCOPE;
             }
         
         } else if (token.kind == Token::RULE_START) {
-            reset_current_branches();
-            current_rule = get_rule_pointer(prev_token, rule_def_scope);
+            current_branch = Branch();
+            current_rule = get_rule_to_define(prev_token, rule_def_scope);
             current_rule->clear();
         
         } else if (token.kind == Token::RULE_APPEND){
-            reset_current_branches();
-            current_rule = get_rule_pointer(prev_token, rule_def_scope);
+            current_branch = Branch();
+            current_rule = get_rule_to_define(prev_token, rule_def_scope);
         
         } else if (token.kind == Token::RULE_END){
-            complete_rule(); current_rule = nullptr;
+            complete_branch(); current_rule = nullptr;
 
         } else if (token.kind == Token::LPAREN){
-            nesting_depth += 1;
+            open_groups.push_back(Branch());
 
         } else if (token.kind == Token::RPAREN){
-            nesting_depth -= 1; 
-
-            next = next_token.get_ok();
-
-            if(!Token::is_wildcard(next.kind)){
-                increment_nesting_depth_base();
-            }
+            close_group();
         
         } else if (token.kind == Token::SEPARATOR){
-            add_current_branches_to_rule();
-            reset_current_branches();
+            if(!open_groups.empty()){
+                throw std::runtime_error(ANNOT("Alternatives inside groups are not supported, in rule " + current_rule->get_name()));
+            }
+
+            complete_branch();
 
         } else if (Token::is_wildcard(token.kind)){
-            extend_current_branches(token);
+            add_repetition(token);
+
+        } else if (token.kind == Token::WEIGHT){
+            set_weight(token);
 
         } else if (token.kind == Token::RBRACE){
             rule_def_scope = NO_SCOPE;
@@ -228,21 +329,7 @@ void Grammar::build_grammar(){
 
         // always peek to prepare for next token
         peek();
-
-        build_grammar();
-
-    } else {
-        ERROR(curr_token.get_error());
     }
-}
-
-/// @brief Does not include meta-grammar tokens
-void Grammar::print_tokens() const {
-    lexer.print_tokens();
-}
 
-void Grammar::print_rules() const {
-    for(const auto& p : rule_pointers){
-        std::cout << p->get_name() << " ";
-    }
+    ERROR(curr_token.get_error());
 }
@@ -0,0 +1,756 @@
+#include <ir.h>
+#include <climits>
+
+namespace Ir {
+
+    namespace {
+
+        /// Budget on the number of repetition counts `solve_repetitions` may try and back out of before giving up on a branch
+        constexpr unsigned int SOLVE_BUDGET = 4096;
+
+        /// Occurances of a kind that open ended repetitions can produce without bound
+        constexpr U64 ANY = UINT64_MAX;
+
+        inline U64 add_bounds(U64 a, U64 b){
+            return ((a == ANY) || (b == ANY) || (a > ANY - 1 - b)) ? ANY : a + b;
+        }
+
+        inline U64 multiply_bounds(U64 a, U64 b){
+            if((a == 0) || (b == 0)) return 0;
+
+            return ((a == ANY) || (b == ANY) || (a > (ANY - 1) / b)) ? ANY : a * b;
+        }
+
+        struct Repetition_slot {
+            const Term* term = nullptr;
+            std::vector<size_t> nested;             // repetitions directly inside the group, in order
+            bool constrained = false;               // whether any constrained rule kind can occur inside the repetition
+            std::vector<unsigned int> per_repeat;   // occurances of each constrained kind one repeat produces outside nested repetitions
+            std::vector<U64> repeat_least;          // fewest occurances of each constrained kind one repeat can produce
+            std::vector<U64> repeat_most;           // most occurances of each constrained kind one repeat can produce, or `ANY`
+            std::vector<U64> least, most;           // the same over the whole repetition
+        };
+
+        /// @brief Record every repetition of a frozen branch in pre-order, along with the bounds on the constrained kinds each can produce.
+        /// Constrained rule kinds that occur directly in the branch are counted into `direct`, and its own repetitions appended to `nested`
+        void collect_repetitions(const Tables& tables, Index branch, std::span<const Kind_count> constraint, std::vector<Repetition_slot>& slots, 
+            std::vector<unsigned int>& direct, std::vector<size_t>& nested){
+            const Branch& br = tables.branches[branch];
+            const size_t n_kinds = constraint.size();
+
+            for(Index t = br.first_term; t < br.first_term + br.n_terms; t++){
+                const Term& term = tables.terms[t];
+
+                if(term.type == TERM_RULE){
+                    for(size_t i = 0; i < n_kinds; i++){
+                        direct[i] += (term.kind == constraint[i].kind);
+                    }
+
+                } else if(term.type == TERM_REPETITION){
+                    size_t index = slots.size();
+                    std::vector<unsigned int> inner(n_kinds, 0);
+                    std::vector<size_t> inner_nested;
+
+                    slots.push_back(Repetition_slot{.term = &term, .nested = {}, .constrained = false, .per_repeat = {}, .repeat_least = {},
+                        .repeat_most = {}, .least = {}, .most = {}});
+                    collect_repetitions(tables, term.value, constraint, slots, inner, inner_nested);
+
+                    Repetition_slot& slot = slots[index];
+
+                    slot.repeat_least.assign(inner.begin(), inner.end());
+                    slot.repeat_most.assign(inner.begin(), inner.end());
+
+                    for(size_t n : inner_nested){
+                        for(size_t i = 0; i < n_kinds; i++){
+                            slot.repeat_least[i] = add_bounds(slot.repeat_least[i], slots[n].least[i]);
+                            slot.repeat_most[i] = add_bounds(slot.repeat_most[i], slots[n].most[i]);
+                        }
+                    }
+
+                    slot.least.resize(n_kinds);
+                    slot.most.resize(n_kinds);
+
+                    for(size_t i = 0; i < n_kinds; i++){
+                        slot.least[i] = multiply_bounds(term.min_repetitions, slot.repeat_least[i]);
+                        slot.most[i] = multiply_bounds(term.open_ended ? ANY : term.max_repetitions, slot.repeat_most[i]);
+                        slot.constrained |= (slot.most[i] > 0);
+                    }
+
+                    slot.per_repeat = std::move(inner);
+                    slot.nested = std::move(inner_nested);
+
+                    nested.push_back(index);
+                }
+            }
+        }
+
+        void fill_counts(const Tables& tables, const Term& term, std::mt19937& rng, uint32_t wildcard_max, bool minimal, std::vector<unsigned int>& counts);
+
+        /// @brief Append the counts of every repetition in the branch, in the layout `Grammar::for_each_term` reads them in
+        void fill_branch_counts(const Tables& tables, Index branch, std::mt19937& rng, uint32_t wildcard_max, bool minimal, std::vector<unsigned int>& counts){
+            const Branch& br = tables.branches[branch];
+
+            if(br.n_repetitions == 0) return;
+
+            for(Index t = br.first_term; t < br.first_term + br.n_terms; t++){
+                if(tables.terms[t].type == TERM_REPETITION){
+                    fill_counts(tables, tables.terms[t], rng, wildcard_max, minimal, counts);
+                }
+            }
+        }
+
+        /// @brief Append the count of a repetition, then the counts of the repetitions nested in each of its repeats
+        void fill_counts(const Tables& tables, const Term& term, std::mt19937& rng, uint32_t wildcard_max, bool minimal, std::vector<unsigned int>& counts){
+            unsigned int n = minimal ? term.min_repetitions : random_int(rng, term.max_repetitions_within(wildcard_max), term.min_repetitions);
+
+            counts.push_back(n);
+
+            if(tables.branches[term.value].n_repetitions == 0) return;
+
+            for(unsigned int r = 0; r < n; r++){
+                fill_branch_counts(tables, term.value, rng, wildcard_max, minimal, counts);
+            }
+        }
+
+        /*
+            depth first search over the counts of every repetition instance of a branch, for `solve_repetitions`. `pending` holds the 
+            repetitions still to be counted, the next one on top, so counts come out in the layout `Grammar::for_each_term` reads.
+            The bounds of the pending repetitions are summed, with those that can produce any number of a kind counted apart, so that 
+            each count is only picked from those that leave the rest of the constraint reachable
+        */
+        struct Count_search {
+            const Tables& tables;
+            const std::vector<Repetition_slot>& slots;
+            std::vector<size_t>& pending;
+            std::vector<int>& remaining;
+            std::vector<U64>& pending_least;
+            std::vector<U64>& pending_most;
+            std::vector<unsigned int>& pending_unbounded;
+            std::vector<unsigned int>& counts;
+            std::mt19937& rng;
+            uint32_t wildcard_max;
+            unsigned int budget;
+
+            /// @brief Add `n` instances of the repetition to the pending bounds, or take them away
+            void pend(size_t s, U64 n, bool add){
+                const Repetition_slot& slot = slots[s];
+
+                for(size_t i = 0; i < remaining.size(); i++){
+                    U64 least = n * slot.least[i];
+
+                    pending_least[i] = add ? pending_least[i] + least : pending_least[i] - least;
+
+                    if(slot.most[i] == ANY){
+                        pending_unbounded[i] = add ? pending_unbounded[i] + n : pending_unbounded[i] - n;
+
+                    } else {
+                        U64 most = n * slot.most[i];
+                        pending_most[i] = add ? pending_most[i] + most : pending_most[i] - most;
+                    }
+                }
+            }
+
+            bool search(){
+                if(pending.empty()){
+                    return std::all_of(remaining.begin(), remaining.end(), [](int n){return n == 0;});
+                }
+
+                size_t s = pending.back();
+                const Repetition_slot& slot = slots[s];
+                const size_t n_kinds = remaining.size();
+                const size_t n_counts = counts.size();
+
+                pending.pop_back();
+                pend(s, 1, false);
+
+                if(!slot.constrained){
+                    fill_counts(tables, *slot.term, rng, wildcard_max, false, counts);
+
+                    if(search()) return true;
+
+                    counts.resize(n_counts);
+                    pend(s, 1, true);
+                    pending.push_back(s);
+
+                    return false;
+                }
+
+                // the constraint bounds how often an open ended repetition producing constrained kinds can repeat, not `wildcard_max`
+                U64 lo = slot.term->min_repetitions, hi = slot.term->open_ended ? ANY : slot.term->max_repetitions;
+                bool feasible = true;
+
+                for(size_t i = 0; (i < n_kinds) && feasible; i++){
+                    U64 left = remaining[i];
+
+                    if(left < pending_least[i]){
+                        feasible = false;
+                        break;
+                    }
+
+                    // enough room must be left for what the other pending repetitions produce at least
+                    if(slot.repeat_least[i]) hi = std::min(hi, (left - pending_least[i]) / slot.repeat_least[i]);
+
+                    // and enough produced for what they can't make up at most
+                    if((pending_unbounded[i] == 0) && (left > pending_most[i])){
+                        U64 short_by = left - pending_most[i];
+
+                        if(slot.repeat_most[i] == ANY){
+                            lo = std::max<U64>(lo, 1);
+
+                        } else if(slot.repeat_most[i] == 0){
+                            feasible = false;
+
+                        } else {
+                            lo = std::max(lo, (short_by + slot.repeat_most[i] - 1) / slot.repeat_most[i]);
+                        }
+                    }
+                }
+
+                // open ended repetitions that needn't produce anything each repeat are only bounded by `wildcard_max`
+                if(hi == ANY) hi = std::max<U64>(lo, wildcard_max);
+
+                hi = std::min<U64>(hi, INT_MAX);
+
+                if(feasible && (lo <= hi)){
+                    int span = hi - lo + 1;
+                    int offset = random_int(rng, span - 1);
+
+                    for(int k = 0; (k < span) && budget; k++){
+                        unsigned int count = lo + (offset + k) % span;
+                        size_t n_pending = pending.size();
+
+                        counts.push_back(count);
+
+                        for(size_t i = 0; i < n_kinds; i++) remaining[i] -= count * slot.per_repeat[i];
+
+                        for(size_t n : slot.nested) pend(n, count, true);
+
+                        for(unsigned int r = 0; r < count; r++){
+                            pending.insert(pending.end(), slot.nested.rbegin(), slot.nested.rend());
+                        }
+
+                        if(search()) return true;
+
+                        budget--;
+
+                        pending.resize(n_pending);
+
+                        for(size_t n : slot.nested) pend(n, count, false);
+
+                        for(size_t i = 0; i < n_kinds; i++) remaining[i] += count * slot.per_repeat[i];
+
+                        counts.resize(n_counts);
+                    }
+                }
+
+                pend(s, 1, true);
+                pending.push_back(s);
+
+                return false;
+            }
+        };
+
+        inline uint32_t saturate(U64 n){
+            return (n >= Grammar::UNBOUNDED) ? Grammar::UNBOUNDED : (uint32_t)n;
+        }
+
+        /// @brief Count the rule kinds of a branch under construction, both outside repetitions and at most overall
+        void collect_kinds(const ::Branch& branch, std::map<Token::Kind, U64>& fixed, std::map<Token::Kind, U64>& most){
+            for(const ::Term& term : branch){
+                if(term.is_rule()){
+                    fixed[term.get_kind()]++;
+                    most[term.get_kind()]++;
+
+                } else if(term.is_repetition()){
+                    std::map<Token::Kind, U64> group_fixed, group_most;
+
+                    collect_kinds(*term.get_group(), group_fixed, group_most);
+
+                    // how often an open ended repetition repeats is only known when generating
+                    for(const auto& [kind, count] : group_most){
+                        most[kind] += term.is_open_ended() ? Grammar::UNBOUNDED : count * term.get_max_repetitions().value();
+                    }
+                }
+            }
+        }
+    }
+
+    Grammar::Grammar(const ::Grammar& grammar): name(grammar.get_name()), path(grammar.get_path()) {
+        const std::vector<std::shared_ptr<::Rule>>& rules = grammar.get_rules();
+
+        std::unordered_map<const ::Rule*, Index> rule_ids;
+        std::unordered_map<std::string, Index> interned;
+
+        auto intern = [&](const std::string& str) -> Index {
+            auto [it, inserted] = interned.try_emplace(str, tables.strings.size());
+
+            if(inserted){
+                tables.strings.push_back(String{.offset = (uint32_t)tables.arena.size(), .length = (uint32_t)str.size()});
+                tables.arena += str;
+            }
+
+            return it->second;
+        };
+
+        for(Index i = 0; i < rules.size(); i++){
+            rule_ids[rules[i].get()] = i;
+        }
+
+        // groups are frozen once every rule's branches are, so that those stay contiguous
+        std::vector<std::pair<Index, std::shared_ptr<const ::Branch>>> pending_groups;
+
+        auto freeze_branch = [&](const ::Branch& branch){
+            std::map<Token::Kind, U64> counts, most;
+
+            collect_kinds(branch, counts, most);
+
+            tables.branches.push_back(Branch{
+                .first_term = (Index)tables.terms.size(),
+                .n_terms = (Index)branch.size(),
+                .first_kind_count = (Index)tables.kind_counts.size(),
+                .n_kind_counts = (Index)counts.size(),
+                .first_repeated_kind = (Index)tables.repeated_kinds.size(),
+                .n_repeated_kinds = 0,
+                .n_repetitions = (Index)branch.num_repetitions(),
+                .weight = branch.get_weight(),
+                .recursive = branch.get_recursive_flag()
+            });
+
+            for(const auto& [kind, count] : counts){
+                tables.kind_counts.push_back(Kind_count{.kind = kind, .count = saturate(count)});
+            }
+
+            for(const auto& [kind, count] : most){
+                if(count > counts[kind]){
+                    tables.repeated_kinds.push_back(Kind_count{.kind = kind, .count = saturate(count - counts[kind])});
+                    tables.branches.back().n_repeated_kinds++;
+                }
+            }
+
+            for(const ::Term& term : branch){
+                Term frozen{.kind = term.get_kind(), .value = 0, .min_repetitions = 0, .max_repetitions = 0, .type = TERM_SYNTAX, .open_ended = 0};
+
+                if(term.is_rule()){
+                    frozen.type = TERM_RULE;
+                    // terms of shared base rules still point at base rules the grammar may have shadowed
+                    frozen.value = rule_ids.at(grammar.resolve(term.get_rule()).get());
+
+                } else if(term.is_syntax()){
+                    frozen.value = intern(term.get_syntax());
+
+                } else {
+                    frozen.type = TERM_REPETITION;
+                    frozen.min_repetitions = term.get_min_repetitions();
+                    frozen.max_repetitions = term.get_max_repetitions().value_or(0);
+                    frozen.open_ended = term.is_open_ended();
+                    pending_groups.push_back({(Index)tables.terms.size(), term.get_group()});
+                }
+
+                tables.terms.push_back(frozen);
+            }
+        };
+
+        for(const std::shared_ptr<::Rule>& rule : rules){
+            const std::vector<::Branch>& branches = rule->get_branches();
+
+            tables.rules.push_back(Rule{
+                .name = intern(rule->get_name()),
+                .kind = rule->get_token().kind,
+                .first_branch = (Index)tables.branches.size(),
+                .n_branches = (Index)branches.size(),
+                .scope = rule->get_scope(),
+                .recursive = rule->get_recursive_flag()
+            });
+
+            for(const ::Branch& branch : branches){
+                freeze_branch(branch);
+            }
+        }
+
+        for(size_t i = 0; i < pending_groups.size(); i++){
+            auto [term_index, group] = pending_groups[i];
+
+            tables.terms[term_index].value = tables.branches.size();
+            freeze_branch(*group);
+        }
+
+        index_rules();
+        analyse();
+        build_alias_tables();
+    }
+
+    Grammar::Grammar(const fs::path& filename, Tables _tables): tables(std::move(_tables)), name(filename.stem()), path(filename) {
+        if(valid()){
+            index_rules();
+            analyse();
+            build_alias_tables();
+        }
+    }
+
+    bool Grammar::valid() const {
+        for(const String& s : tables.strings){
+            if((U64)s.offset + s.length > tables.arena.size()) return false;
+        }
+
+        for(const Rule& rule : tables.rules){
+            if((rule.name >= tables.strings.size()) || ((U64)rule.first_branch + rule.n_branches > tables.branches.size())) return false;
+        }
+
+        for(Index b = 0; b < tables.branches.size(); b++){
+            const Branch& branch = tables.branches[b];
+
+            if(((U64)branch.first_term + branch.n_terms > tables.terms.size()) ||
+                ((U64)branch.first_kind_count + branch.n_kind_counts > tables.kind_counts.size()) ||
+                ((U64)branch.first_repeated_kind + branch.n_repeated_kinds > tables.repeated_kinds.size()) ||
+                !std::isfinite(branch.weight) || (branch.weight < 0.0f)){
+                return false;
+            }
+
+            for(Index t = branch.first_term; t < branch.first_term + branch.n_terms; t++){
+                const Term& term = tables.terms[t];
+
+                switch(term.type){
+                    case TERM_RULE: if(term.value >= tables.rules.size()) return false; break;
+                    case TERM_SYNTAX: if(term.value >= tables.strings.size()) return false; break;
+                    // groups come strictly later, which also rules out cycles
+                    case TERM_REPETITION: if((term.value <= b) || (term.value >= tables.branches.size())) return false; break;
+                    default: return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    void Grammar::index_rules(){
+        for(Index i = 0; i < tables.rules.size(); i++){
+            auto& slots = rule_index[std::string(rule_name(i))];
+
+            for(U8 scope = NO_SCOPE; scope <= ALL_SCOPES; scope++){
+                if(!slots.matching[scope].has_value() && scope_matches(tables.rules[i].scope, scope)){
+                    slots.matching[scope] = i;
+                }
+            }
+
+            std::optional<Index>& exact = slots.exact[tables.rules[i].scope & ALL_SCOPES];
+            if(!exact.has_value()) exact = i;
+        }
+    }
+
+    std::optional<Index> Grammar::find_rule(const std::string& name, const U8& scope) const {
+        auto it = rule_index.find(name);
+
+        if(it == rule_index.end()){
+            return std::nullopt;
+        } else {
+            return it->second.matching[scope & ALL_SCOPES];
+        }
+    }
+
+    std::optional<Index> Grammar::find_exact_rule(const std::string& name, const U8& scope) const {
+        auto it = rule_index.find(name);
+
+        // rules are only ever defined with scopes within `ALL_SCOPES`
+        if((it == rule_index.end()) || (scope & ~ALL_SCOPES)){
+            return std::nullopt;
+        } else {
+            return it->second.exact[scope];
+        }
+    }
+
+    unsigned int Grammar::count_rule_occurances(Index branch, const Token::Kind& kind) const {
+        const Branch& b = tables.branches[branch];
+
+        auto first = tables.kind_counts.begin() + b.first_kind_count, last = first + b.n_kind_counts;
+        auto it = std::lower_bound(first, last, kind, [](const Kind_count& entry, const Token::Kind& k){return entry.kind < k;});
+
+        return ((it != last) && (it->kind == kind)) ? it->count : 0;
+    }
+
+    unsigned int Grammar::max_repeated_occurances(Index branch, const Token::Kind& kind) const {
+        const Branch& b = tables.branches[branch];
+
+        auto first = tables.repeated_kinds.begin() + b.first_repeated_kind, last = first + b.n_repeated_kinds;
+        auto it = std::lower_bound(first, last, kind, [](const Kind_count& entry, const Token::Kind& k){return entry.kind < k;});
+
+        return ((it != last) && (it->kind == kind)) ? it->count : 0;
+    }
+
+    /// @brief Alias table of every rule over the weights its branches are given in the grammar
+    void Grammar::build_alias_tables(){
+        rule_aliases.clear();
+        rule_aliases.reserve(tables.rules.size());
+
+        for(const Rule& rule : tables.rules){
+            std::vector<float> weights;
+
+            for(Index b = rule.first_branch; b < rule.first_branch + rule.n_branches; b++){
+                weights.push_back(tables.branches[b].weight);
+            }
+
+            rule_aliases.emplace_back(weights);
+        }
+    }
+
+    /*
+        Minimum depth and size of every rule and branch, found by relaxing to a fixed point from `UNBOUNDED`. Groups always come after
+        the branch holding them, so going through branches backwards settles groups first within each pass
+    */
+    void Grammar::analyse(){
+        const size_t n_rules = tables.rules.size(), n_branches = tables.branches.size();
+
+        rule_depths.assign(n_rules, UNBOUNDED);
+        rule_sizes.assign(n_rules, UNBOUNDED);
+        branch_depths.assign(n_branches, UNBOUNDED);
+        branch_sizes.assign(n_branches, UNBOUNDED);
+
+        bool changed = true;
+
+        while(changed){
+            changed = false;
+
+            for(size_t b = n_branches; b-- > 0;){
+                const Branch& branch = tables.branches[b];
+                U64 depth = 0, size = 0;
+
+                for(Index t = branch.first_term; t < branch.first_term + branch.n_terms; t++){
+                    const Term& term = tables.terms[t];
+
+                    if(term.type == TERM_SYNTAX){
+                        size += 1;
+
+                    } else if(term.type == TERM_RULE){
+                        depth = std::max<U64>(depth, rule_depths[term.value]);
+                        size += rule_sizes[term.value];
+
+                    } else if(term.min_repetitions > 0){
+                        depth = std::max<U64>(depth, branch_depths[term.value]);
+                        size += (U64)term.min_repetitions * branch_sizes[term.value];
+                    }
+                }
+
+                if((saturate(depth) < branch_depths[b]) || (saturate(size) < branch_sizes[b])){
+                    branch_depths[b] = std::min(branch_depths[b], saturate(depth));
+                    branch_sizes[b] = std::min(branch_sizes[b], saturate(size));
+                    changed = true;
+                }
+            }
+
+            for(size_t r = 0; r < n_rules; r++){
+                const Rule& rule = tables.rules[r];
+
+                // a rule with no branches is a leaf
+                U64 depth = (rule.n_branches == 0) ? 0 : UNBOUNDED, size = depth;
+
+                for(Index b = rule.first_branch; b < rule.first_branch + rule.n_branches; b++){
+                    depth = std::min<U64>(depth, branch_depths[b]);
+                    size = std::min<U64>(size, branch_sizes[b]);
+                }
+
+                uint32_t new_depth = (depth == UNBOUNDED) ? UNBOUNDED : saturate(depth + 1);
+                uint32_t new_size = (size == UNBOUNDED) ? UNBOUNDED : saturate(size + 1);
+
+                if((new_depth < rule_depths[r]) || (new_size < rule_sizes[r])){
+                    rule_depths[r] = std::min(rule_depths[r], new_depth);
+                    rule_sizes[r] = std::min(rule_sizes[r], new_size);
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    std::vector<bool> Grammar::reachable_rules(Index entry) const {
+        std::vector<bool> reachable(tables.rules.size(), false);
+        std::vector<bool> visited_branches(tables.branches.size(), false);
+        std::vector<Index> rules_to_visit = {entry};
+
+        reachable[entry] = true;
+
+        while(!rules_to_visit.empty()){
+            const Rule& rule = tables.rules[rules_to_visit.back()];
+            rules_to_visit.pop_back();
+
+            std::vector<Index> branches_to_visit;
+
+            for(Index b = rule.first_branch; b < rule.first_branch + rule.n_branches; b++){
+                branches_to_visit.push_back(b);
+            }
+
+            while(!branches_to_visit.empty()){
+                Index b = branches_to_visit.back();
+                branches_to_visit.pop_back();
+
+                if(visited_branches[b]) continue;
+                visited_branches[b] = true;
+
+                const Branch& branch = tables.branches[b];
+
+                for(Index t = branch.first_term; t < branch.first_term + branch.n_terms; t++){
+                    const Term& term = tables.terms[t];
+
+                    if((term.type == TERM_RULE) && !reachable[term.value]){
+                        reachable[term.value] = true;
+                        rules_to_visit.push_back(term.value);
+
+                    } else if(term.type == TERM_REPETITION){
+                        branches_to_visit.push_back(term.value);
+                    }
+                }
+            }
+        }
+
+        return reachable;
+    }
+
+    void Grammar::print_analysis(std::ostream& stream, std::optional<Index> entry) const {
+        std::vector<bool> reachable = entry.has_value() ? reachable_rules(entry.value()) : std::vector<bool>(tables.rules.size(), true);
+
+        auto str = [](uint32_t n){return (n == UNBOUNDED) ? std::string("unbounded") : std::to_string(n);};
+
+        size_t n_unreachable = 0, n_unbounded = 0;
+
+        for(Index r = 0; r < tables.rules.size(); r++){
+            const Rule& rule = tables.rules[r];
+            size_t n_terminating = 0;
+
+            for(Index b = rule.first_branch; b < rule.first_branch + rule.n_branches; b++){
+                n_terminating += is_terminating_branch(r, b);
+            }
+
+            stream << rule_name(r) << STR_SCOPE(rule.scope) << ": min depth " << str(rule_depths[r]) << ", min size " << str(rule_sizes[r])
+                << ", " << n_terminating << "/" << rule.n_branches << " terminating branches";
+
+            if(!reachable[r]){
+                stream << YELLOW(" (unreachable)");
+                n_unreachable++;
+            }
+
+            if(rule_depths[r] == UNBOUNDED){
+                stream << RED(" (never terminates)");
+                n_unbounded++;
+            }
+
+            stream << std::endl;
+        }
+
+        stream << tables.rules.size() << " rules, " << n_unreachable << " unreachable";
+
+        if(entry.has_value()) stream << " from " << rule_name(entry.value());
+
+        stream << ", " << n_unbounded << " that never terminate" << std::endl;
+    }
+
+    std::vector<unsigned int> Grammar::random_repetitions(Index branch, std::mt19937& rng, uint32_t wildcard_max, bool minimal) const {
+        std::vector<unsigned int> counts;
+
+        if(tables.branches[branch].n_repetitions == 0) return counts;
+
+        counts.reserve(tables.branches[branch].n_repetitions);
+
+        fill_branch_counts(tables, branch, rng, wildcard_max, minimal, counts);
+
+        return counts;
+    }
+
+    /*
+        Every repetition instance is counted in the order the terms are expanded, so repetitions nested in a group get a count of 
+        their own for each repeat. Counts that can't change how many constrained kinds a branch produces are random, the rest are 
+        searched for
+    */
+    std::optional<std::vector<unsigned int>> Grammar::solve_repetitions(Index branch, std::span<const Kind_count> constraint, std::mt19937& rng, 
+        uint32_t wildcard_max) const {
+        const size_t n_kinds = constraint.size();
+
+        std::vector<Repetition_slot> slots;
+        std::vector<unsigned int> fixed(n_kinds, 0);
+        std::vector<size_t> top;
+
+        slots.reserve(tables.branches[branch].n_repetitions);
+
+        collect_repetitions(tables, branch, constraint, slots, fixed, top);
+
+        std::vector<int> remaining(n_kinds);
+
+        for(size_t i = 0; i < n_kinds; i++){
+            remaining[i] = (int)constraint[i].count - (int)fixed[i];
+            if(remaining[i] < 0) return std::nullopt;
+        }
+
+        std::vector<size_t> pending(top.rbegin(), top.rend());
+        std::vector<U64> pending_least(n_kinds, 0), pending_most(n_kinds, 0);
+        std::vector<unsigned int> pending_unbounded(n_kinds, 0);
+        std::vector<unsigned int> counts;
+
+        counts.reserve(slots.size());
+
+        Count_search solver{
+            .tables = tables, .slots = slots, .pending = pending, .remaining = remaining, .pending_least = pending_least, 
+            .pending_most = pending_most, .pending_unbounded = pending_unbounded, .counts = counts, .rng = rng, .wildcard_max = wildcard_max,
+            .budget = SOLVE_BUDGET
+        };
+
+        for(size_t s : top) solver.pend(s, 1, true);
+
+        if(solver.search()){
+            return counts;
+        } else {
+            return std::nullopt;
+        }
+    }
+
+    void Grammar::print_branch(std::ostream& stream, Index branch) const {
+        const Branch& b = tables.branches[branch];
+
+        for(Index t = b.first_term; t < b.first_term + b.n_terms; t++){
+            const Term& term = tables.terms[t];
+
+            if(term.type == TERM_SYNTAX){
+                stream << std::quoted(string(term.value));
+
+            } else if(term.type == TERM_RULE){
+                stream << rule_name(term.value);
+
+            } else {
+                stream << "( ";
+                print_branch(stream, term.value);
+                stream << "){" << term.min_repetitions << ",";
+
+                if(!term.open_ended) stream << term.max_repetitions;
+
+                stream << "}";
+            }
+
+            stream << " ";
+        }
+
+        if(b.weight != 1.0f) stream << "@" << b.weight << " ";
+    }
+
+    std::ostream& operator<<(std::ostream& stream, const Grammar& grammar){
+        for(const Rule& rule : grammar.tables.rules){
+            stream << grammar.string(rule.name) << " = ";
+
+            for(Index b = rule.first_branch; b < rule.first_branch + rule.n_branches; b++){
+                grammar.print_branch(stream, b);
+                if(b < rule.first_branch + rule.n_branches - 1) stream << " | ";
+            }
+
+            stream << " ; " << STR_SCOPE(rule.scope) << std::endl << std::endl;
+        }
+
+        return stream;
+    }
+
+    void Grammar::print_rules() const {
+        for(Index i = 0; i < tables.rules.size(); i++){
+            std::cout << rule_name(i) << " ";
+        }
+    }
+
+    /// @brief Does not include meta-grammar tokens. The file is lexed again since the frozen grammar keeps no tokens
+    void Grammar::print_tokens() const {
+        Lexer::Lexer lexer(path.string());
+        lexer.print_tokens();
+    }
+
+}
@@ -1,54 +1,171 @@
 #include <lex.h>
 
+/// @brief Single pass scanner over the whole grammar file. Identifiers are matched maximally then classified through the keyword table,
+/// everything else is decided by the current character and at most one character of lookahead
 void Lexer::Lexer::lex(){
-    std::string input, matched_string;
     std::vector<Token::Token> tokens;
-    std::ifstream stream(_filename);
-    
-    std::regex full_pattern(FULL_REGEX, std::regex::icase);
+    std::ifstream stream(_filename, std::ios::in | std::ios::binary);
+    std::string input;
 
-    std::sregex_iterator end;
+    if(stream){
+        stream.seekg(0, std::ios::end);
+        input.resize(stream.tellg());
+        stream.seekg(0, std::ios::beg);
+        stream.read(input.data(), input.size());
+    }
 
-    while(std::getline(stream, input)){
-        
-        std::sregex_iterator begin(input.begin(), input.end(), full_pattern);
+    const size_t n = input.size();
+    size_t i = 0;
+
+    auto skip_line = [&](){
+        while((i < n) && (input[i] != '\n')) i++;
+    };
+
+    tokens.reserve(n / 4);
 
-        for(std::sregex_iterator i = begin; (i != end); ++i){
-            std::smatch match = *i;
-            matched_string = match.str();
+    while(i < n){
+        const char c = input[i];
 
-            if(string_is(matched_string, R"(#)")){
+        switch(CHAR_CLASSES[(U8)c]){
+
+            case CC_SPACE: case CC_NEWLINE: case CC_DIGIT: case CC_OTHER:
+                i++;
                 break;
 
-            } else if(string_is(matched_string, R"(\(\*)")){
-                ignore = true;
+            case CC_IDENT_START: {
+                size_t start = i;
+
+                while((i < n) && ((CHAR_CLASSES[(U8)input[i]] == CC_IDENT_START) || (CHAR_CLASSES[(U8)input[i]] == CC_DIGIT))) i++;
+
+                std::string_view word(input.data() + start, i - start);
+                const Keyword* keyword = find_keyword(word);
+
+                if(keyword == nullptr){
+                    tokens.push_back(Token::Token{std::string(word), Token::RULE});
+
+                } else if(keyword->kind == Token::SYNTAX){
+                    tokens.push_back(Token::Token{std::string(keyword->value), Token::SYNTAX});
+
+                } else {
+                    // scope keywords may be used as a prefix, i.e EXTERNAL::qubit_defs
+                    bool is_scope = (keyword->kind == Token::EXTERNAL) || (keyword->kind == Token::INTERNAL) || (keyword->kind == Token::OWNED);
+
+                    if(is_scope && (input.compare(i, 2, "::") == 0)) i += 2;
+
+                    tokens.push_back(Token::Token{input.substr(start, i - start), keyword->kind});
+                }
+
                 break;
-            
-            } else if (string_is(matched_string, R"(\*\))")){
-                ignore = false;
+            }
+
+            case CC_QUOTE: {
+                // strings cannot span lines, an unterminated quote is ignored
+                size_t end = i + 1;
+
+                while((end < n) && (input[end] != c) && (input[end] != '\n')) end++;
+
+                if((end < n) && (input[end] == c)){
+                    tokens.push_back(Token::Token{remove_outer_quotes(input.substr(i, end - i + 1)), Token::SYNTAX});
+                    i = end + 1;
+                } else {
+                    i++;
+                }
+
                 break;
+            }
+
+            case CC_PUNCT: {
+                const char next = (i + 1 < n) ? input[i + 1] : '\0';
+
+                switch(c){
+                    case '#':
+                        skip_line();
+                        break;
+
+                    case '(':
+                        if(next == '*'){
+                            // multi-line comment, the rest of the line after both the opening and closing markers is ignored
+                            size_t end = input.find("*)", i + 2);
 
-            } else {
-            
-                for(const Token::Rule& tr : TOKEN_RULES){
-                    if(string_is(matched_string, tr.pattern)){
+                            i = (end == std::string::npos) ? n : end + 2;
+                            skip_line();
 
-                        if(tr.kind == Token::SYNTAX){
-                            tokens.push_back(Token::Token{remove_outer_quotes(tr.value.value_or(matched_string)), tr.kind});                        
-                        
                         } else {
-                            tokens.push_back(Token::Token{tr.value.value_or(matched_string), tr.kind});                        
+                            tokens.push_back(Token::Token{"(", Token::LPAREN}); i++;
                         }
+                        break;
 
+                    case '+':
+                        if(next == '='){
+                            tokens.push_back(Token::Token{"+=", Token::RULE_APPEND}); i += 2;
+                        } else {
+                            tokens.push_back(Token::Token{"+", Token::ONE_OR_MORE}); i++;
+                        }
+                        break;
+
+                    case '-':
+                        if(next == '>'){
+                            tokens.push_back(Token::Token{"->", Token::ARROW}); i += 2;
+                        } else {
+                            i++;
+                        }
+                        break;
+
+                    case ')': tokens.push_back(Token::Token{")", Token::RPAREN}); i++; break;
+                    case '[': tokens.push_back(Token::Token{"[", Token::LBRACK}); i++; break;
+                    case ']': tokens.push_back(Token::Token{"]", Token::RBRACK}); i++; break;
+                    case '{': {
+                        // repetition bounds {n}, {m,} {,n} or {m,n}, otherwise an opening brace
+                        size_t end = i + 1;
+                        std::string bounds;
+
+                        while((end < n) && (isdigit(input[end]) || (input[end] == ',') || (input[end] == ' '))){
+                            if(input[end] != ' ') bounds += input[end];
+                            end++;
+                        }
+
+                        bool is_range = (end < n) && (input[end] == '}') && (std::count(bounds.begin(), bounds.end(), ',') <= 1) &&
+                            std::any_of(bounds.begin(), bounds.end(), ::isdigit);
+
+                        if(is_range){
+                            tokens.push_back(Token::Token{bounds, Token::RANGE}); i = end + 1;
+                        } else {
+                            tokens.push_back(Token::Token{"{", Token::LBRACE}); i++;
+                        }
+                        break;
+                    }
+
+                    case '@': {
+                        // weight of the branch it follows, a bare @ is ignored
+                        size_t end = i + 1;
+
+                        while((end < n) && (isdigit(input[end]) || (input[end] == '.'))) end++;
+
+                        if(end > i + 1){
+                            tokens.push_back(Token::Token{input.substr(i + 1, end - i - 1), Token::WEIGHT});
+                        }
+
+                        i = end;
                         break;
                     }
+
+                    case '}': tokens.push_back(Token::Token{"}", Token::RBRACE}); i++; break;
+                    case '=': tokens.push_back(Token::Token{"=", Token::RULE_START}); i++; break;
+                    case ':': tokens.push_back(Token::Token{":", Token::RULE_START}); i++; break;
+                    case '|': tokens.push_back(Token::Token{"|", Token::SEPARATOR}); i++; break;
+                    case ';': tokens.push_back(Token::Token{";", Token::RULE_END}); i++; break;
+                    case '*': tokens.push_back(Token::Token{"*", Token::ZERO_OR_MORE}); i++; break;
+                    case '?': tokens.push_back(Token::Token{"?", Token::OPTIONAL}); i++; break;
+                    default: i++; break;
                 }
+
+                break;
             }
         }
     }
 
     tokens.push_back(Token::Token{.value = "", .kind = Token::_EOF});        
-    result.set_ok(tokens);
+    result.set_ok(std::move(tokens));
 }
 
 void Lexer::Lexer::print_tokens() const {
@@ -57,10 +174,10 @@ void Lexer::Lexer::print_tokens() const {
         ERROR(result.get_error()); 
         
     } else {
-        std::vector<Token::Token> tokens = result.get_ok();
+        const std::vector<Token::Token>& tokens = result.get_ok();
 
         for(size_t i = 0; i < tokens.size(); ++i){
             std::cout << tokens[i] << std::endl;
         }
     }
-}
\ No newline at end of file
+}
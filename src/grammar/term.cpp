@@ -1,16 +1,22 @@
 #include <term.h>
 #include <rule.h>
+#include <sstream>
 
-Term::Term(const std::shared_ptr<Rule> rule, const Token::Kind& _kind, unsigned int _branch_nesting_depth){
+Term::Term(const std::shared_ptr<Rule> rule, const Token::Kind& _kind){
     value = rule;
     kind = _kind;
-    branch_nesting_depth = _branch_nesting_depth;
 }
 
-Term::Term(const std::string& syntax, const Token::Kind& _kind, unsigned int _branch_nesting_depth){
+Term::Term(const std::string& syntax, const Token::Kind& _kind){
     value = syntax;
     kind = _kind;
-    branch_nesting_depth = _branch_nesting_depth; 
+}
+
+Term::Term(const std::shared_ptr<const Branch> group, const Token::Kind& _kind, unsigned int _min_repetitions, std::optional<unsigned int> _max_repetitions){
+    value = group;
+    kind = _kind;
+    min_repetitions = _min_repetitions;
+    max_repetitions = _max_repetitions;
 }
 
 std::shared_ptr<Rule> Term::get_rule() const {
@@ -21,8 +27,22 @@ std::string Term::get_syntax() const {
     return std::get<std::string>(value);
 }
 
+std::shared_ptr<const Branch> Term::get_group() const {
+    return std::get<std::shared_ptr<const Branch>>(value);
+}
+
 std::string Term::get_string() const {
-    return is_rule() ? std::get<std::shared_ptr<Rule>>(value)->get_name() : std::get<std::string>(value);
+    if(is_rule()){
+        return get_rule()->get_name();
+
+    } else if(is_syntax()){
+        return get_syntax();
+
+    } else {
+        std::ostringstream stream;
+        stream << *this;
+        return stream.str();
+    }
 }
 
 U8 Term::get_scope() const { 
@@ -37,12 +57,23 @@ bool Term::is_rule() const {
     return std::holds_alternative<std::shared_ptr<Rule>>(value);
 }
 
+bool Term::is_repetition() const {
+    return std::holds_alternative<std::shared_ptr<const Branch>>(value);
+}
+
 std::ostream& operator<<(std::ostream& stream, Term term){
     if(term.is_syntax()){
         stream << std::quoted(term.get_syntax());
         
-    } else {
+    } else if(term.is_rule()){
         stream << term.get_rule()->get_name();
+
+    } else {
+        stream << "( " << *term.get_group() << "){" << term.get_min_repetitions() << ",";
+
+        if(!term.is_open_ended()) stream << term.get_max_repetitions().value();
+
+        stream << "}";
     }
 
     return stream;
@@ -54,7 +85,11 @@ bool Term::operator==(const Term& other) const {
     
     } else if (is_syntax() && other.is_syntax()){
         return get_syntax() == other.get_syntax();
+
+    } else if (is_repetition() && other.is_repetition()){
+        return (get_group() == other.get_group()) && (min_repetitions == other.min_repetitions) && (max_repetitions == other.max_repetitions);
+
     } else {
         return false;
     }    
-}
\ No newline at end of file
+}
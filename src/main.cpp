@@ -3,9 +3,60 @@
 #include <vector>
 #include <run.h>
 
-int main(){
+int main(int argc, char** argv){
+
+    bool lazy = false;
+    unsigned int n_threads = 0;
+    std::optional<U64> seed;
+    Common::Limits limits;
+
+    for(int i = 1; i < argc; i++){
+        std::string arg(argv[i]);
+
+        try{
+            if(arg == "--lazy"){
+                // only build a grammar once it is first used
+                lazy = true;
+
+            } else if((arg == "--threads") && (i + 1 < argc)){
+                // number of programs built at once, one per core by default
+                std::string count(argv[++i]);
+                std::optional<U64> n = parse_unsigned(count, UINT_MAX);
+
+                if(!n.has_value() || (n.value() == 0)) throw std::out_of_range(count);
+
+                n_threads = n.value();
+
+            } else if((arg == "--seed") && (i + 1 < argc)){
+                // master seed of the whole run, random by default
+                std::string master(argv[++i]);
+                seed = parse_unsigned(master);
+
+                if(!seed.has_value()) throw std::out_of_range(master);
+
+            } else if((arg == "--limit") && (i + 1 < argc) && limits.set(argv[i + 1])){
+                // limit every grammar starts with, as name=value
+                i++;
+
+            } else {
+                throw std::invalid_argument(arg);
+            }
+
+        } catch (const std::logic_error&) {
+            std::cerr << "Usage: " << argv[0] << " [--lazy] [--threads n] [--seed n] [--limit name=value]..." << std::endl;
+            return 1;
+        }
+    }
+
+    try{
+        limits.check();
+
+    } catch (const std::runtime_error& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
     
-    Run run("../grammar_definitions");
+    Run run("../grammar_definitions", lazy, n_threads, seed, limits);
     run.loop();
 
     return 0;
@@ -1,46 +1,39 @@
 #include <run.h>
 #include <ast.h>
 #include <lex.h>
+#include <cache.h>
 
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
 
-Run::Run(const std::string& _grammars_dir) : grammars_dir(_grammars_dir) {
 
-    std::vector<Token::Token> meta_grammar_tokens;
-    
-    // build all grammars
+Run::Run(const std::string& _grammars_dir, bool _lazy, unsigned int n_threads, std::optional<U64> seed, const Common::Limits& _limits) : 
+    grammars_dir(_grammars_dir), lazy(_lazy), limits(_limits) {
+
+    flags.n_threads = n_threads;
+    master_seed = seed.value_or(((U64)std::random_device{}() << 32) | std::random_device{}());
+
+    std::cout << "Master seed: " << master_seed << std::endl;
+
     try{
 
         if(fs::exists(grammars_dir) && fs::is_directory(grammars_dir)){
-            /*
-                find meta grammar
-            */
-            for(auto& file : fs::directory_iterator(grammars_dir)){
-
-                if(file.is_regular_file() && (file.path().stem() == Common::META_GRAMMAR_NAME)){                    
-                    Lexer::Lexer lexer(file.path().string());
-                    meta_grammar_tokens = std::move(lexer.get_tokens());
-                    
-                    // remove EOF from meta grammar's tokens
-                    meta_grammar_tokens.pop_back();
-                    break;
-                }
-            }
 
-            /*
-                parse all other grammars, appending the tokens grammar to each one
-            */
-            for(auto& file : fs::directory_iterator(grammars_dir)){
+            cache_dir = grammars_dir.parent_path() / Common::GRAMMAR_CACHE_FOLDER_NAME;
+
+            {
+                std::lock_guard<std::mutex> lock(grammars_mutex);
 
-                if(file.is_regular_file() && (file.path().extension() == ".qf") && (file.path().stem() != Common::META_GRAMMAR_NAME)){
+                find_grammar_files();
 
-                    Grammar grammar(file, meta_grammar_tokens);
-                    grammar.build_grammar();
+                std::vector<std::string> names;
 
-                    std::string name = grammar.get_name();
-                    std::cout << "Built " << name << std::endl;
-                    
-                    generators[name] = std::make_shared<Generator>(grammar);
+                for(const auto& [name, file] : grammar_files){
+                    if(!lazy) names.push_back(name);
                 }
+
+                build_grammars(names);
             }
 
             /* 
@@ -62,6 +55,294 @@ Run::Run(const std::string& _grammars_dir) : grammars_dir(_grammars_dir) {
 
 }
 
+Run::~Run(){
+    watching = false;
+
+    if(watcher.joinable()){
+        watcher.join();
+    }
+}
+
+void Run::find_grammar_files(){
+    /*
+        find the meta grammar and every grammar that is appended to it
+    */
+    grammar_files.clear();
+    meta_grammar_path.clear();
+
+    for(auto& file : fs::directory_iterator(grammars_dir)){
+
+        if(file.is_regular_file() && (file.path().extension() == ".qf")){
+
+            if(file.path().stem() == Common::META_GRAMMAR_NAME){
+                meta_grammar_path = file.path();
+            } else {
+                grammar_files[file.path().stem().string()] = file.path();
+            }
+        }
+    }
+
+    meta_grammar_hash = hash_file(meta_grammar_path);
+}
+
+std::shared_ptr<const Ir::Grammar> Run::load_grammar(const fs::path& file, U64 key, std::string& status){
+
+    fs::path cache_path = cache_dir / (file.stem().string() + ".qfc");
+
+    std::optional<Ir::Grammar> cached = Cache::load(file, cache_path, key);
+
+    if(cached.has_value()){
+        status = "Loaded " + cached.value().get_name() + " from cache";
+        return std::make_shared<const Ir::Grammar>(std::move(cached.value()));
+    }
+
+    std::shared_ptr<const Grammar> base;
+
+    {
+        std::lock_guard<std::mutex> lock(meta_grammar_mutex);
+
+        if(!meta_grammar_path.empty() && (built_meta_grammar_hash != meta_grammar_hash)){
+            auto built = std::make_shared<Grammar>(meta_grammar_path);
+            built->build_grammar();
+
+            meta_grammar = built;
+            built_meta_grammar_hash = meta_grammar_hash;
+        }
+
+        base = meta_grammar;
+    }
+
+    Grammar grammar(file, base);
+    grammar.build_grammar();
+
+    auto frozen = std::make_shared<const Ir::Grammar>(grammar);
+
+    Cache::save(*frozen, cache_path, key);
+
+    status = "Built " + frozen->get_name();
+    return frozen;
+}
+
+void Run::build_grammars(const std::vector<std::string>& names){
+
+    struct Job {
+        std::string name;
+        fs::path file;
+        U64 key;
+        std::shared_ptr<const Ir::Grammar> grammar;
+        std::string status;
+        std::exception_ptr error;
+    };
+
+    std::vector<Job> jobs;
+
+    for(const auto& name : names){
+        const fs::path& file = grammar_files.at(name);
+        jobs.push_back(Job{.name = name, .file = file, .key = Cache::key(file, meta_grammar_hash), .grammar = nullptr, .status = "", .error = nullptr});
+    }
+
+    /*
+        grammars share nothing while building but the meta grammar's tokens, so each worker takes the next grammar until none are left
+    */
+    std::atomic<size_t> next = 0;
+    size_t n_workers = std::min<size_t>(jobs.size(), std::max(1U, std::thread::hardware_concurrency()));
+    std::vector<std::thread> workers;
+
+    for(size_t w = 0; w < n_workers; w++){
+        workers.emplace_back([&](){
+            for(size_t j = next++; j < jobs.size(); j = next++){
+                try{
+                    jobs[j].grammar = load_grammar(jobs[j].file, jobs[j].key, jobs[j].status);
+                } catch (...) {
+                    jobs[j].error = std::current_exception();
+                }
+            }
+        });
+    }
+
+    for(auto& worker : workers){
+        worker.join();
+    }
+
+    // report in name order, so that output doesn't depend on which thread finished first
+    for(auto& job : jobs){
+        try{
+            if(job.error) std::rethrow_exception(job.error);
+
+        } catch (const std::exception& error) {
+            ERROR("Could not build " + job.name + ": " + error.what());
+            continue;
+        }
+
+        std::cout << job.status << std::endl;
+
+        // swapping the pointer leaves the old generator alive for whoever still holds it
+        std::shared_ptr<Generator> generator = std::make_shared<Generator>(job.grammar);
+
+        // the weights set on the grammar before it was reloaded are set again on the new one
+        auto previous = generators.find(job.name);
+
+        if((previous != generators.end()) && generator->carry_weights(*previous->second)){
+            INFO("Kept the branch weights set on " + job.name);
+        }
+
+        fs::path limits_file = limits_path(job.file);
+        Common::Limits grammar_limits = limits;
+
+        if(fs::exists(limits_file)){
+            try{
+                grammar_limits.load(limits_file);
+                INFO("Limits of " + job.name + " read from " + limits_file.string());
+
+            } catch (const std::runtime_error& error) {
+                ERROR("Ignoring limits of " + job.name + ": " + error.what());
+                grammar_limits = limits;
+            }
+        }
+
+        generator->set_limits(grammar_limits);
+
+        generators[job.name] = generator;
+        grammar_keys[job.name] = job.key;
+        limits_hashes[job.name] = hash_file(limits_file);
+    }
+}
+
+std::shared_ptr<Generator> Run::get_generator(const std::string& name){
+
+    std::lock_guard<std::mutex> lock(grammars_mutex);
+
+    if(generators.find(name) == generators.end()){
+        build_grammars({name});
+    }
+
+    auto it = generators.find(name);
+
+    return (it != generators.end()) ? it->second : nullptr;
+}
+
+void Run::reload_grammars(){
+
+    std::lock_guard<std::mutex> lock(grammars_mutex);
+
+    find_grammar_files();
+
+    for(auto it = generators.begin(); it != generators.end();){
+        if(grammar_files.find(it->first) == grammar_files.end()){
+            INFO("Removed " + it->first);
+            grammar_keys.erase(it->first);
+            limits_hashes.erase(it->first);
+            it = generators.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    std::vector<std::string> changed;
+
+    for(const auto& [name, file] : grammar_files){
+        auto key = grammar_keys.find(name);
+
+        if(key != grammar_keys.end()){
+            // new limits don't change the grammar, which then comes straight from the cache, but they do need a new generator
+            if((key->second != Cache::key(file, meta_grammar_hash)) || (limits_hashes[name] != hash_file(limits_path(file)))){
+                changed.push_back(name);
+            }
+
+        } else if(!lazy){
+            changed.push_back(name);
+        }
+    }
+
+    build_grammars(changed);
+}
+
+void Run::refresh_current_generator(){
+
+    if(current_generator == nullptr) return;
+
+    std::shared_ptr<Generator> latest;
+
+    {
+        std::lock_guard<std::mutex> lock(grammars_mutex);
+        auto it = generators.find(current_grammar_name);
+        if(it != generators.end()) latest = it->second;
+    }
+
+    if((latest != nullptr) && (latest != current_generator)){
+        current_generator = latest;
+        current_generator->setup_builder(current_entry_name, current_scope);
+        INFO("Using reloaded " + current_grammar_name);
+    }
+}
+
+void Run::toggle_watch(){
+
+    if(watching){
+        watching = false;
+        watcher.join();
+
+    } else {
+        // the watcher stops itself if it couldn't start
+        if(watcher.joinable()) watcher.join();
+
+        watching = true;
+        watcher = std::thread(&Run::watch_grammars, this);
+    }
+
+    INFO("Grammar watch mode " + FLAG_STATUS(watching));
+}
+
+void Run::watch_grammars(){
+
+    int fd = inotify_init1(IN_NONBLOCK);
+
+    if((fd < 0) || (inotify_add_watch(fd, grammars_dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0)){
+        ERROR("Could not watch " + grammars_dir.string());
+        if(fd >= 0) close(fd);
+        watching = false;
+        return;
+    }
+
+    std::array<char, 4096> buffer;
+    bool pending = false;
+
+    /*
+        editors tend to write a file in a few steps, so reload once events for grammar or limits files stop arriving for a poll period
+    */
+    while(watching){
+        pollfd poll_fd{.fd = fd, .events = POLLIN, .revents = 0};
+
+        if(poll(&poll_fd, 1, 200) > 0){
+            ssize_t length;
+
+            while((length = read(fd, buffer.data(), buffer.size())) > 0){
+                for(ssize_t offset = 0; offset < length;){
+                    const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+
+                    if(event->len){
+                        fs::path extension = fs::path(event->name).extension();
+                        pending |= (extension == ".qf") || (extension == ".limits");
+                    }
+
+                    offset += sizeof(inotify_event) + event->len;
+                }
+            }
+
+        } else if(pending){
+            pending = false;
+
+            try{
+                reload_grammars();
+            } catch (const fs::filesystem_error& error) {
+                ERROR(error.what());
+            }
+        }
+    }
+
+    close(fd);
+}
+
 void Run::set_grammar(){
 
     std::string grammar_name = tokens[0], entry_name;
@@ -78,14 +359,42 @@ void Run::set_grammar(){
     }
 
     if(is_grammar(grammar_name)){
-        current_generator = generators[grammar_name];
+        std::shared_ptr<Generator> generator = get_generator(grammar_name);
+        if(generator == nullptr) return;
+
+        current_generator = generator;
         current_generator->setup_builder(entry_name, scope);
 
+        current_grammar_name = grammar_name;
+        current_entry_name = entry_name;
+        current_scope = scope;
+
     } else {
         std::cout << grammar_name << " is not a known grammar!" << std::endl;
     }
 }
 
+void Run::replay(const std::string& grammar_name, U64 seed, int circuit_number){
+
+    if(!is_grammar(grammar_name)){
+        std::cout << grammar_name << " is not a known grammar!" << std::endl;
+        return;
+    }
+
+    std::shared_ptr<Generator> generator = get_generator(grammar_name);
+    if(generator == nullptr) return;
+
+    // a grammar that was never set is replayed from its usual entry
+    if((generator != current_generator) && !generator->entry_set()){
+        generator->setup_builder("program", NO_SCOPE);
+    }
+
+    fs::path replay_dir = output_dir / "replay";
+
+    fs::remove_all(replay_dir);
+    generator->replay(replay_dir, circuit_number, seed, flags);
+}
+
 void Run::tokenise(const std::string& command, const char& delim){
 
     std::stringstream ss(command);
@@ -130,10 +439,25 @@ void Run::print_progress_bar(unsigned int current) {
 void Run::help(){
     std::cout << "-> Type enter to write to a file" << std::endl;
     std::cout << "-> \"grammar_name grammar_entry\" : command to set grammar " << std::endl;
+    std::cout << "-> \"weight rule branch w\" : pick the branch (counting from 0) of a rule with weight w, \"reset_weights\" : undo this" << std::endl;
+    std::cout << "-> \"reload\" : rebuild grammars whose definitions changed, \"watch\" : do so whenever one is saved" << std::endl;
+    std::cout << "-> \"replay grammar seed [n]\" : build the program with the seed in its seed.txt again, numbered n (0 by default)" << std::endl;
+    std::cout << "-> \"stream\" : write random programs out as they are derived instead of building the whole tree first" << std::endl;
+    std::cout << "-> \"limits\" : show the size limits of the current grammar, \"limit name value\" : change one of them" << std::endl;
+    std::cout << "-> \"target qubit_ops min_depth width\" : build main circuits with exactly that many qubit ops, at least that deep, over that many qubits"
+        << " (0 leaves depth or width to chance), \"no_target\" : undo this" << std::endl;
     std::cout << "  These are the known grammar rules: " << std::endl;
 
-    for(const auto& generator : generators){
-        std::cout << generator.second << std::endl;
+    std::lock_guard<std::mutex> lock(grammars_mutex);
+
+    for(const auto& [name, file] : grammar_files){
+        auto it = generators.find(name);
+
+        if(it != generators.end()){
+            std::cout << *it->second << std::endl;
+        } else {
+            std::cout << name << " (built when first set)" << std::endl;
+        }
     }
 }
 
@@ -152,9 +476,9 @@ void Run::run_tests(){
             results_file << "Running test: " << entry.path().filename() << std::endl;
             
             fs::path program_path = entry.path() / ("circuit.py");
-            std::string command = "python3 " + program_path.string() + (Common::plot ? " --plot" : "") + " 2>&1";
+            std::string command = "python3 " + program_path.string() + (flags.plot ? " --plot" : "") + " 2>&1";
             
-            results_file << pipe_from_command(command) << std::endl;
+            results_file << pipe_from_command(command, flags.verbose) << std::endl;
 
             print_progress_bar(current);                       
         }              
@@ -175,12 +499,35 @@ void Run::loop(){
         std::getline(std::cin, current_command);
         tokenise(current_command, ' ');
 
+        // the watcher may have swapped in a new generator since the last command
+        refresh_current_generator();
+
         if(tokens.size() == 2){
             set_grammar();
 
         } else if(current_command == "h"){
             help();
 
+        } else if(current_command == "reload"){
+            reload_grammars();
+            refresh_current_generator();
+
+        } else if(current_command == "watch"){
+            toggle_watch();
+
+        } else if(((tokens.size() == 3) || (tokens.size() == 4)) && (tokens[0] == "replay")){
+            try{
+                int circuit_number = (tokens.size() == 4) ? std::stoi(tokens[3]) : 0;
+                std::optional<U64> seed = parse_unsigned(tokens[2]);
+
+                if(!seed.has_value()) throw std::out_of_range(tokens[2]);
+
+                replay(tokens[1], seed.value(), circuit_number);
+
+            } catch (const std::logic_error&) {
+                ERROR("Usage: replay <grammar> <seed> [circuit number]");
+            }
+
         } else if (current_command == "quit"){
             break;
 
@@ -191,41 +538,125 @@ void Run::loop(){
             
             } else if (current_command == "print_tokens"){
                 current_generator->print_tokens();
+
+            } else if (current_command == "analyse"){
+                current_generator->print_analysis();
+
+            } else if ((tokens.size() == 4) && (tokens[0] == "weight")){
+                try{
+                    int branch = std::stoi(tokens[2]);
+
+                    if(branch < 0) throw std::out_of_range(tokens[2]);
+                    current_generator->set_weight(tokens[1], branch, std::stof(tokens[3]));
+
+                } catch (const std::exception&) {
+                    ERROR("Usage: weight <rule> <branch> <weight>");
+                }
+
+            } else if (current_command == "limits"){
+                std::cout << current_generator->get_limits();
+
+            } else if ((tokens.size() == 3) && (tokens[0] == "limit")){
+                Common::Limits new_limits = current_generator->get_limits();
+
+                if(!new_limits.set(tokens[1] + "=" + tokens[2])){
+                    ERROR("Usage: limit <name> <value>, with one of the names listed by \"limits\" and a value up to " + std::to_string(INT_MAX));
+
+                } else {
+                    try{
+                        new_limits.check();
+                        current_generator->set_limits(new_limits);
+                        INFO("Limit " + tokens[1] + " set to " + tokens[2]);
+
+                    } catch (const std::runtime_error& error) {
+                        ERROR(error.what());
+                    }
+                }
+
+            } else if (current_command == "reset_weights"){
+                current_generator->reset_weights();
+                INFO("Branch weights reset to those in the grammar");
             
             } else if (current_command == "plot"){
-                Common::plot = !Common::plot;
-                INFO("Plot mode is now " + FLAG_STATUS(Common::plot));
+                flags.plot = !flags.plot;
+                INFO("Plot mode is now " + FLAG_STATUS(flags.plot));
             
             } else if (current_command == "verbose"){
-                Common::verbose = !Common::verbose;
-                INFO("Verbose mode is now " + FLAG_STATUS(Common::verbose));
+                flags.verbose = !flags.verbose;
+                INFO("Verbose mode is now " + FLAG_STATUS(flags.verbose));
 
             } else if (current_command == "render_dags"){
-                Common::render_dags = !Common::render_dags;
-                INFO("DAG render " + FLAG_STATUS(Common::render_dags));
+                flags.render_dags = !flags.render_dags;
+                INFO("DAG render " + FLAG_STATUS(flags.render_dags));
 
             } else if (current_command == "run_tests"){
                 run_tests();
                 
             } else if (current_command == "swarm_testing") {
-                Common::swarm_testing = !Common::swarm_testing;
-                INFO("Swarm testing mode " + FLAG_STATUS(Common::swarm_testing));
+                flags.swarm_testing = !flags.swarm_testing;
+                INFO("Swarm testing mode " + FLAG_STATUS(flags.swarm_testing));
+
+            } else if (current_command == "stream"){
+                flags.streaming = !flags.streaming;
+                INFO("Streaming generation " + FLAG_STATUS(flags.streaming));
+
+            } else if ((tokens.size() == 4) && (tokens[0] == "target")){
+                try{
+                    // sizes end up as bounds of `random_int` like the limits do, so they are checked against INT_MAX before narrowing
+                    std::optional<U64> n_qubit_ops = parse_unsigned(tokens[1], INT_MAX);
+                    std::optional<U64> min_depth = parse_unsigned(tokens[2], INT_MAX);
+                    std::optional<U64> width = parse_unsigned(tokens[3], INT_MAX);
+
+                    if(!n_qubit_ops.has_value() || !min_depth.has_value() || !width.has_value()) throw std::out_of_range(current_command);
+
+                    Common::Size_target target{
+                        .n_qubit_ops = (unsigned int)n_qubit_ops.value(), 
+                        .min_depth = (unsigned int)min_depth.value(), 
+                        .width = (unsigned int)width.value()
+                    };
+
+                    unsigned int max_qubits = current_generator->get_limits().max_qubits;
+
+                    if((target.n_qubit_ops == 0) || (target.min_depth > target.n_qubit_ops)){
+                        ERROR("A size target needs at least 1 qubit op, and no more depth than qubit ops");
+
+                    } else if((target.width != 0) && (target.width < Common::WIDEST_GATE_QUBITS)){
+                        ERROR("A size target needs a width of at least " + std::to_string(Common::WIDEST_GATE_QUBITS) + ", the most qubits a gate acts on");
+
+                    } else if(target.width > max_qubits){
+                        ERROR("A size target needs a width of at most " + std::to_string(max_qubits) + ", the grammar's max_qubits");
+
+                    } else {
+                        flags.size_target = target;
+                        INFO("Size targeted generation on, " + tokens[1] + " qubit ops, depth at least " + tokens[2] + ", width " + tokens[3]);
+                    }
+
+                } catch (const std::logic_error&) {
+                    ERROR("Usage: target <qubit ops> <min depth> <width>");
+                }
+
+            } else if (current_command == "no_target"){
+                flags.size_target = std::nullopt;
+                INFO("Size targeted generation off");
 
             } else if (current_command == "genetic"){
-                Common::run_genetic = !Common::run_genetic;
-                INFO("Genetic generation mode " + FLAG_STATUS(Common::run_genetic));
+                flags.run_genetic = !flags.run_genetic;
+                INFO("Genetic generation mode " + FLAG_STATUS(flags.run_genetic));
 
             } else if ((n_programs = safe_stoi(current_command))){
                 remove_all_in_dir(output_dir);
 
-                if(Common::run_genetic){
-                    current_generator->run_genetic(output_dir, n_programs.value_or(0));
+                if(flags.run_genetic){
+                    current_generator->run_genetic(output_dir, n_programs.value_or(0), split_seed(master_seed, n_generated), flags);
 
                 } else {
-                    current_generator->generate_random_programs(output_dir, n_programs.value_or(0));
+                    current_generator->generate_random_programs(output_dir, n_programs.value_or(0), master_seed, n_generated, flags);
 
                 }
 
+                // programs in the next batch get seeds of their own
+                n_generated += n_programs.value_or(0);
+
             }
 
         } else {
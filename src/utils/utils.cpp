@@ -1,13 +1,7 @@
 #include <utils.h>
 #include <sstream>
-
-namespace Common {
-    bool plot = false;
-    bool verbose = false;
-    bool render_dags = false;
-    bool run_genetic = false;
-    bool swarm_testing = false;
-}
+#include <fstream>
+#include <charconv>
 
 void lower(std::string& str){
     std::transform(str.begin(), str.end(), str.begin(),
@@ -32,21 +26,48 @@ U64 hash_rule_name(std::string rule_name) {
     return hash;
 }
 
-std::mt19937& seed(){
-    static std::mt19937 random_gen{
-        std::random_device{}()
-    };
-    return random_gen;
+/// @brief FNV hash of a file's contents, chained onto `hash` so several files can be combined into one key. Missing files hash as empty
+/// @param path 
+/// @param hash 
+/// @return 
+U64 hash_file(const fs::path& path, U64 hash){
+    const U64 prime = 1099511628211ULL;
+
+    std::ifstream stream(path, std::ios::in | std::ios::binary);
+    std::array<char, 4096> buffer;
+
+    while(stream.read(buffer.data(), buffer.size()) || stream.gcount()){
+        for(std::streamsize i = 0; i < stream.gcount(); i++){
+            hash ^= static_cast<uint8_t>(buffer[i]);
+            hash *= prime;
+        }
+    }
+
+    return hash;
+}
+
+/// @brief SplitMix64 finaliser over the master seed stepped `index + 1` times
+/// @param master 
+/// @param index 
+/// @return 
+U64 split_seed(U64 master, U64 index){
+    U64 z = master + (index + 1) * 0x9e3779b97f4a7c15ULL;
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+    return z ^ (z >> 31);
 }
 
 /// @brief Random integer within some range
+/// @param rng generator of the build asking, never shared between threads
 /// @param max value inclusive
 /// @param min value inclusive
 /// @return
-int random_int(int max, int min){
+int random_int(std::mt19937& rng, int max, int min){
     if(min < max){
         std::uniform_int_distribution<int> int_dist(min, max);
-        return int_dist(seed());
+        return int_dist(rng);
 
     } else {
         return min;
@@ -54,13 +75,14 @@ int random_int(int max, int min){
 }
 
 /// @brief Random float within some range
+/// @param rng generator of the build asking, never shared between threads
 /// @param max value inclusive
 /// @param min value inclusive
 /// @return 
-float random_float(float max, float min){
+float random_float(std::mt19937& rng, float max, float min){
     if(min < max){
         std::uniform_real_distribution<float> float_dist(min, max);
-        return float_dist(seed());
+        return float_dist(rng);
 
     } else {
         return min;
@@ -79,6 +101,16 @@ std::optional<int> safe_stoi(const std::string& str) {
     }
 }
 
+std::optional<U64> parse_unsigned(std::string_view str, U64 max){
+    // from_chars takes no sign, so negative values are rejected rather than wrapped around
+    U64 n;
+    auto [end, error] = std::from_chars(str.data(), str.data() + str.size(), n);
+
+    if((error != std::errc()) || (end != str.data() + str.size()) || str.empty() || (n > max)) return std::nullopt;
+
+    return n;
+}
+
 /// @brief Find all possible combinations that can be chosen from numbers in [0, n-1]
 /// Knew the solution had something to do with counting in binary, but I didn't come up with this algorithm myself
 /// https://stackoverflow.com/questions/12991758/creating-all-possible-k-combinations-of-n-items-in-c
@@ -128,10 +160,10 @@ int vector_max(std::vector<int> in){
 }
 
 
-void pipe_to_command(std::string command, std::string write){
+void pipe_to_command(std::string command, std::string write, bool verbose){
     FILE* pipe = popen(command.c_str(), "w");
 
-    if(Common::verbose){
+    if(verbose){
         INFO("Running: " + command);
         INFO("Piping: " + write + " to command");
     }
@@ -147,7 +179,7 @@ void pipe_to_command(std::string command, std::string write){
     }
 }
 
-std::string pipe_from_command(std::string command){
+std::string pipe_from_command(std::string command, bool verbose){
     FILE* pipe = popen(command.c_str(), "r");
 
     if(!pipe){
@@ -165,7 +197,7 @@ std::string pipe_from_command(std::string command){
         ERROR("Command " + command + " failed");
     }
 
-    if(Common::verbose){
+    if(verbose){
         INFO("Run command " + command);
     }
 
@@ -178,17 +210,21 @@ std::string escape(const std::string& str){
     return oss.str();
 }
 
+/// @brief Colours only tell flow paths apart in rendered DAGs, so they come from a generator of their own rather than the build's,
+/// and rendering never changes what gets generated
+/// @return 
 std::string random_hex_colour(){
 
+    thread_local std::minstd_rand colour_gen{std::random_device{}()};
     std::uniform_int_distribution<int> int_dist(0, 255);
 
     std::ostringstream ss;
 
     ss << "#"
     << std::hex << std::setfill('0')
-    << std::setw(2) << int_dist(seed()) 
-    << std::setw(2) << int_dist(seed()) 
-    << std::setw(2) << int_dist(seed());
+    << std::setw(2) << int_dist(colour_gen) 
+    << std::setw(2) << int_dist(colour_gen) 
+    << std::setw(2) << int_dist(colour_gen);
 
     return ss.str();
 }
@@ -199,4 +235,112 @@ bool scope_matches(const U8& a, const U8& b){
     } else {
         return a & b;
     }
-}
\ No newline at end of file
+}
+
+namespace Common {
+
+    /*
+        every limit by the name it is set with
+    */
+    static const std::array<std::pair<const char*, unsigned int Limits::*>, 11> LIMIT_NAMES = {{
+        {"min_qubits", &Limits::min_qubits},
+        {"max_qubits", &Limits::max_qubits},
+        {"min_bits", &Limits::min_bits},
+        {"max_bits", &Limits::max_bits},
+        {"max_subroutines", &Limits::max_subroutines},
+        {"nested_max_depth", &Limits::nested_max_depth},
+        {"wildcard_max", &Limits::wildcard_max},
+        {"derivation_depth_budget", &Limits::derivation_depth_budget},
+        {"derivation_node_budget", &Limits::derivation_node_budget},
+        {"derivation_node_limit", &Limits::derivation_node_limit},
+        {"build_time_limit", &Limits::build_time_limit},
+    }};
+
+    /// @brief Surrounding whitespace dropped
+    static std::string_view trim(std::string_view str){
+        size_t first = str.find_first_not_of(" \t\r");
+
+        if(first == std::string_view::npos) return {};
+
+        return str.substr(first, str.find_last_not_of(" \t\r") - first + 1);
+    }
+
+    bool Limits::set(const std::string& name, unsigned int value){
+        // limits end up as bounds of `random_int`, which takes an int
+        if(value > INT_MAX) return false;
+
+        for(const auto& [limit_name, member] : LIMIT_NAMES){
+            if(name == limit_name){
+                this->*member = value;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool Limits::set(const std::string& assignment){
+        size_t equals = assignment.find('=');
+
+        if(equals == std::string::npos) return false;
+
+        std::string_view name = trim(std::string_view(assignment).substr(0, equals));
+        std::string_view value = trim(std::string_view(assignment).substr(equals + 1));
+
+        std::optional<U64> n = parse_unsigned(value, UINT_MAX);
+
+        return n.has_value() && set(std::string(name), (unsigned int)n.value());
+    }
+
+    void Limits::load(const fs::path& path){
+        std::ifstream stream(path);
+        std::string line;
+        unsigned int line_number = 0;
+
+        if(!stream.is_open()){
+            throw std::runtime_error(ANNOT("Cannot open " + path.string()));
+        }
+
+        while(std::getline(stream, line)){
+            line_number++;
+
+            std::string_view content = trim(std::string_view(line).substr(0, line.find('#')));
+
+            if(content.empty()) continue;
+
+            if(!set(std::string(content))){
+                throw std::runtime_error(ANNOT(path.string() + ":" + std::to_string(line_number) + ": expected \"name = value\" with a known limit and a value up to " + std::to_string(INT_MAX)));
+            }
+        }
+
+        check();
+    }
+
+    void Limits::check() const {
+        // every block needs enough qubits for the widest gate to act on distinct ones
+        if((min_qubits < WIDEST_GATE_QUBITS) || (min_qubits > max_qubits)){
+            throw std::runtime_error(ANNOT("Qubit limits need " + std::to_string(WIDEST_GATE_QUBITS) + " <= min_qubits <= max_qubits, as gates act on up to " + std::to_string(WIDEST_GATE_QUBITS) + " qubits"));
+        }
+
+        if((min_bits == 0) || (min_bits > max_bits)){
+            throw std::runtime_error(ANNOT("Bit limits need 0 < min_bits <= max_bits"));
+        }
+
+        if(wildcard_max == 0){
+            throw std::runtime_error(ANNOT("wildcard_max must be at least 1"));
+        }
+
+        if(derivation_node_budget > derivation_node_limit){
+            throw std::runtime_error(ANNOT("derivation_node_budget can't be over derivation_node_limit"));
+        }
+    }
+
+    std::ostream& operator<<(std::ostream& stream, const Limits& limits){
+        for(const auto& [name, member] : LIMIT_NAMES){
+            stream << "  " << name << " = " << limits.*member << std::endl;
+        }
+
+        return stream;
+    }
+
+}
@@ -0,0 +1,50 @@
+#include <test.h>
+#include <alias_table.h>
+
+/*
+    branches of weight 0 are never drawn, however the other weights round. Rounding in setup can leave a column of weight 0 
+    without a partner, which must still always give way to its alias
+*/
+
+int main(){
+
+    std::mt19937 rng(0);
+
+    for(int t = 0; t < 2000; t++){
+        size_t n = 2 + random_int(rng, 30);
+        std::vector<float> weights(n);
+
+        for(float& weight : weights){
+            // a mix of zeros, tiny and large weights, so that the scaled weights don't add up exactly
+            switch(random_int(rng, 3)){
+                case 0: weight = 0.0f; break;
+                case 1: weight = random_float(rng, 1e-6f); break;
+                case 2: weight = random_float(rng, 1.0f); break;
+                default: weight = random_float(rng, 1e6f); break;
+            }
+        }
+
+        weights[random_int(rng, n - 1)] = 1.0f;
+
+        Alias_table table(weights);
+
+        for(int i = 0; i < 2000; i++){
+            size_t index = table.sample(rng);
+
+            CHECK(index < n);
+            CHECK(weights[index] > 0.0f);
+
+            if((index >= n) || (weights[index] <= 0.0f)) return Test::result("alias_table_test");
+        }
+    }
+
+    // all zero picks uniformly
+    Alias_table uniform(std::vector<float>(4, 0.0f));
+    std::vector<int> seen(4, 0);
+
+    for(int i = 0; i < 4000; i++) seen[uniform.sample(rng)]++;
+
+    for(int count : seen) CHECK(count > 0);
+
+    return Test::result("alias_table_test");
+}
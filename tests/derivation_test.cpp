@@ -0,0 +1,113 @@
+#include <test.h>
+#include <ast.h>
+
+/*
+    a derivation can be suspended and carried on, saved and resumed in another builder, or cancelled, and still make the program
+    an uninterrupted build of the same seed makes
+*/
+
+static std::string text_of(Result<Program>& res){
+    std::ostringstream text;
+
+    if(res.is_ok()){
+        text << res.get_ok().get_root();
+    } else {
+        std::cerr << res.get_error() << std::endl;
+    }
+
+    return text.str();
+}
+
+int main(){
+
+    auto grammar = Test::grammar_from("derivation_test",
+        "text = word word+ ;\n"
+        "word = \"a\" | \"b\" | \"(\" text \")\" ;\n"
+    );
+
+    Ir::Index text = grammar->find_rule("text").value();
+    std::optional<Node_constraint> gateset = std::nullopt;
+    std::ostringstream report;
+
+    Ast ast;
+    ast.set_entry(grammar, text);
+
+    ast.seed(7);
+    Result<Program> whole = ast.build(std::nullopt, gateset, report);
+    std::string expected = text_of(whole);
+
+    CHECK(whole.is_ok());
+    CHECK(expected.size() > 10);
+
+    // suspended every few nodes
+    ast.seed(7);
+    CHECK(ast.start(std::nullopt, gateset, report));
+
+    unsigned int n_suspended = 0;
+    Derivation_status status;
+
+    while((status = ast.derive(3)) == DS_SUSPENDED) n_suspended++;
+
+    Result<Program> sliced = ast.finish();
+
+    CHECK(status == DS_DONE);
+    CHECK(n_suspended > 1);
+    CHECK(text_of(sliced) == expected);
+
+    // saved part way, carried on here, then resumed from the same state by a fork and by this builder
+    ast.seed(7);
+    CHECK(ast.start(std::nullopt, gateset, report));
+    CHECK(ast.derive(5) == DS_SUSPENDED);
+
+    std::optional<Derivation_state> saved = ast.save();
+    CHECK(saved.has_value());
+
+    CHECK(ast.derive() == DS_DONE);
+    Result<Program> carried_on = ast.finish();
+    CHECK(text_of(carried_on) == expected);
+
+    if(saved.has_value()){
+        Derivation_state copy = saved.value();
+
+        std::shared_ptr<Ast> fork = ast.fork();
+        fork->seed(1234);
+
+        CHECK(fork->resume(saved.value(), report));
+        CHECK(fork->derive() == DS_DONE);
+
+        Result<Program> resumed = fork->finish();
+        CHECK(text_of(resumed) == expected);
+
+        ast.seed(1234);
+        CHECK(ast.resume(copy, report));
+        CHECK(ast.derive() == DS_DONE);
+
+        Result<Program> resumed_again = ast.finish();
+        CHECK(text_of(resumed_again) == expected);
+
+        // a builder that can't derive as far as the saved build had doesn't resume it
+        Common::Limits tight = ast.get_limits();
+        tight.derivation_node_limit = 3;
+
+        std::shared_ptr<Ast> limited = ast.fork();
+        limited->set_limits(tight);
+
+        CHECK(!limited->resume(copy, report));
+    }
+
+    // cancelled part way, it stays cancelled until the next build starts
+    ast.seed(7);
+    CHECK(ast.start(std::nullopt, gateset, report));
+    CHECK(ast.derive(2) == DS_SUSPENDED);
+
+    ast.cancel();
+
+    CHECK(ast.derive() == DS_CANCELLED);
+    CHECK(ast.derive() == DS_CANCELLED);
+
+    ast.seed(7);
+    Result<Program> after_cancel = ast.build(std::nullopt, gateset, report);
+    CHECK(text_of(after_cancel) == expected);
+
+    return Test::result("derivation_test");
+}
@@ -0,0 +1,56 @@
+#include <test.h>
+
+/*
+    limits that would leave a block with fewer qubits than the widest gate acts on are rejected, along with minimums over their
+    maximums
+*/
+
+static bool passes_check(const Common::Limits& limits){
+    try {
+        limits.check();
+        return true;
+
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+}
+
+int main(){
+
+    Common::Limits limits;
+    CHECK(passes_check(limits));
+
+    // a single qubit per block can't hold a ccx or cswap
+    CHECK(limits.set("min_qubits=1"));
+    CHECK(limits.set("max_qubits=1"));
+    CHECK(!passes_check(limits));
+
+    CHECK(limits.set("min_qubits", Common::WIDEST_GATE_QUBITS - 1));
+    CHECK(limits.set("max_qubits", Common::WIDEST_GATE_QUBITS));
+    CHECK(!passes_check(limits));
+
+    CHECK(limits.set("min_qubits", Common::WIDEST_GATE_QUBITS));
+    CHECK(passes_check(limits));
+
+    // wide enough, but over the maximum
+    CHECK(limits.set("min_qubits", Common::WIDEST_GATE_QUBITS + 1));
+    CHECK(!passes_check(limits));
+
+    CHECK(limits.set("max_qubits", Common::WIDEST_GATE_QUBITS + 1));
+    CHECK(passes_check(limits));
+
+    // negative values aren't wrapped around
+    CHECK(!limits.set("min_qubits=-1"));
+    CHECK(!limits.set("min_qubits=4294967296"));
+
+    // nor are seeds and counts, which are checked before they are converted
+    CHECK(parse_unsigned("18446744073709551615") == UINT64_MAX);
+    CHECK(!parse_unsigned("18446744073709551616").has_value());
+    CHECK(!parse_unsigned("-1").has_value());
+    CHECK(!parse_unsigned("+1").has_value());
+    CHECK(!parse_unsigned("12x").has_value());
+    CHECK(!parse_unsigned("").has_value());
+    CHECK(!parse_unsigned("2147483648", INT_MAX).has_value());
+
+    return Test::result("limits_test");
+}
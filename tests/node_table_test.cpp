@@ -0,0 +1,62 @@
+#include <test.h>
+#include <node.h>
+
+/*
+    children are linked in the table in the order they are added, a node placed under more than one parent prints under each, and
+    a node with children in one program's table can't be given more in another's
+*/
+
+static std::string text_of(const Node& node){
+    std::ostringstream text;
+    text << node;
+    return text.str();
+}
+
+int main(){
+
+    Node_table table;
+
+    auto root = std::make_shared<Node>("root", Token::COMPOUND_STMTS);
+    auto shared = std::make_shared<Node>("shared", Token::COMPOUND_STMT);
+    auto other = std::make_shared<Node>("other", Token::COMPOUND_STMT);
+
+    table.add_child(*shared, std::make_shared<Node>("x"));
+    table.add_child(*shared, std::make_shared<Node>("y"));
+
+    table.add_child(*root, std::make_shared<Node>("a"));
+    table.add_child(*root, shared);
+    table.add_child(*other, shared);
+    table.add_child(*root, std::make_shared<Node>("b"));
+    table.add_child(*other, shared);
+
+    CHECK(root->get_num_children() == 3);
+    CHECK(shared->get_num_children() == 2);
+    CHECK(other->get_num_children() == 2);
+
+    CHECK(text_of(*root) == "axyb");
+    CHECK(text_of(*other) == "xyxy");
+
+    // a leaf has no row anywhere
+    auto leaf = std::make_shared<Node>("leaf");
+    CHECK(leaf->get_num_children() == 0);
+    CHECK(text_of(*leaf) == "leaf");
+
+    Node_table next;
+    bool threw = false;
+
+    try {
+        next.add_child(*root, std::make_shared<Node>("c"));
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+
+    CHECK(threw);
+    CHECK(root->get_num_children() == 3);
+
+    // its children are still walked in the table they were added in
+    auto holder = std::make_shared<Node>("holder", Token::COMPOUND_STMTS);
+    next.add_child(*holder, root);
+    CHECK(text_of(*holder) == "axyb");
+
+    return Test::result("node_table_test");
+}
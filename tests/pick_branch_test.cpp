@@ -0,0 +1,61 @@
+#include <test.h>
+#include <ast.h>
+
+/*
+    past the derivation budgets branches that terminate are picked first, but never at the cost of the node's constraint
+*/
+
+int main(){
+
+    /*
+        the terminating branch of `stmts` may pass a constraint of 3 qubit ops going by its bounds, but only ever has an even number
+        of them. Only the recursive branch can meet it
+    */
+    auto grammar = Test::grammar_from("pick_branch_test",
+        "stmts = \"pass\" (qubit_op qubit_op)* | qubit_op qubit_op qubit_op stmts ;\n"
+        "qubit_op = \"h\" ;\n"
+    );
+
+    Ir::Index stmts = grammar->find_rule("stmts").value();
+    Ir::Index recursive = grammar->rule(stmts).first_branch + 1;
+
+    CHECK(grammar->is_terminating_branch(stmts, grammar->rule(stmts).first_branch));
+    CHECK(!grammar->is_terminating_branch(stmts, recursive));
+
+    Ast ast;
+    ast.set_entry(grammar, stmts);
+    ast.seed(0);
+
+    Common::Limits limits;
+    limits.derivation_depth_budget = 0;
+    ast.set_limits(limits);
+
+    auto node = std::make_shared<Node>("stmts", Token::RULE);
+    node->add_constraint(Token::QUBIT_OP, 3);
+
+    for(int i = 0; i < 100; i++){
+        std::vector<unsigned int> repetitions;
+
+        try {
+            std::optional<Ir::Index> branch = ast.pick_branch(stmts, node, repetitions);
+            CHECK(branch == std::make_optional(recursive));
+
+            if(branch != std::make_optional(recursive)) break;
+
+        } catch (const std::exception& error) {
+            CHECK(!"pick_branch threw");
+            std::cerr << error.what() << std::endl;
+            break;
+        }
+    }
+
+    // without a constraint the terminating branch is the only one picked past the budget
+    auto free_node = std::make_shared<Node>("stmts", Token::RULE);
+
+    for(int i = 0; i < 100; i++){
+        std::vector<unsigned int> repetitions;
+        CHECK(ast.pick_branch(stmts, free_node, repetitions) == std::make_optional(grammar->rule(stmts).first_branch));
+    }
+
+    return Test::result("pick_branch_test");
+}
@@ -0,0 +1,72 @@
+#include <test.h>
+
+/*
+    repetitions nested in a repetition get counts of their own for each repeat, so constraints that need the repeats to differ 
+    can still be met, and those no counts meet are never
+*/
+
+static std::vector<unsigned int> kinds_made(const Ir::Grammar& grammar, Ir::Index branch, const std::vector<unsigned int>& counts){
+    std::vector<unsigned int> made(2, 0);
+
+    grammar.for_each_term(branch, counts, [&](const Ir::Term& term){
+        made[0] += (term.kind == Token::QUBIT_OP);
+        made[1] += (term.kind == Token::GATE_OP);
+    });
+
+    return made;
+}
+
+int main(){
+
+    auto grammar = Test::grammar_from("solve_repetitions_test",
+        "x = (gate_op qubit_op+)+ ;\n"
+        "y = (gate_op (qubit_op{1,2} \"z\"*)+)* qubit_op ;\n"
+        "gate_op = \"g\" ;\n"
+        "qubit_op = \"h\" ;\n"
+    );
+
+    std::mt19937 rng(0);
+
+    for(const char* name : {"x", "y"}){
+        Ir::Index branch = grammar->rule(grammar->find_rule(name).value()).first_branch;
+
+        // {qubit ops, gate ops}, where a single repeat of the outer group can't make 5 qubit ops in `y`
+        for(const auto& [n_qubit_ops, n_gate_ops] : std::vector<std::pair<unsigned int, unsigned int>>{{3, 1}, {5, 2}, {11, 2}, {7, 1}}){
+            std::vector<Ir::Kind_count> constraint = {{Token::QUBIT_OP, n_qubit_ops}, {Token::GATE_OP, n_gate_ops}};
+
+            for(int i = 0; i < 50; i++){
+                std::optional<std::vector<unsigned int>> counts = grammar->solve_repetitions(branch, constraint, rng, 5);
+
+                CHECK(counts.has_value());
+
+                if(!counts.has_value()) break;
+
+                bool meets = (kinds_made(*grammar, branch, counts.value()) == std::vector<unsigned int>{n_qubit_ops, n_gate_ops});
+                CHECK(meets);
+
+                if(!meets) break;
+            }
+        }
+    }
+
+    // every repeat of `x` makes a qubit op per gate op, and `y` makes one after its repetition
+    Ir::Index x = grammar->rule(grammar->find_rule("x").value()).first_branch;
+    Ir::Index y = grammar->rule(grammar->find_rule("y").value()).first_branch;
+
+    std::vector<Ir::Kind_count> too_few = {{Token::QUBIT_OP, 2}, {Token::GATE_OP, 3}};
+    std::vector<Ir::Kind_count> none = {{Token::QUBIT_OP, 0}, {Token::GATE_OP, 0}};
+
+    CHECK(!grammar->solve_repetitions(x, too_few, rng, 5).has_value());
+    CHECK(!grammar->solve_repetitions(x, none, rng, 5).has_value());
+    CHECK(!grammar->solve_repetitions(y, none, rng, 5).has_value());
+
+    // counts picked without a constraint are laid out the same way
+    for(int i = 0; i < 50; i++){
+        std::vector<unsigned int> counts = grammar->random_repetitions(y, rng, 5);
+        std::vector<unsigned int> made = kinds_made(*grammar, y, counts);
+
+        CHECK(made[0] >= made[1] + 1);
+    }
+
+    return Test::result("solve_repetitions_test");
+}
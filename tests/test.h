@@ -0,0 +1,49 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <utils.h>
+#include <grammar.h>
+#include <ir.h>
+
+/*
+    what the tests share: checks that count failures rather than stopping at the first, and grammars built from text
+*/
+
+namespace Test {
+
+    inline int failures = 0;
+
+    /// @brief Frozen grammar of `text`, written to a temporary file named after `name` and built without a base
+    inline std::shared_ptr<const Ir::Grammar> grammar_from(const std::string& name, const std::string& text){
+        fs::path path = fs::temp_directory_path() / (name + ".qf");
+        std::ofstream(path) << text;
+
+        Grammar grammar(path);
+        grammar.build_grammar();
+
+        fs::remove(path);
+
+        return std::make_shared<const Ir::Grammar>(grammar);
+    }
+
+    /// @brief Exit code of the test, after saying how it went
+    inline int result(const std::string& name){
+        if(failures){
+            std::cerr << name << ": " << failures << " check(s) failed" << std::endl;
+            return 1;
+        }
+
+        std::cout << name << ": passed" << std::endl;
+        return 0;
+    }
+}
+
+#define CHECK(condition) \
+    do { \
+        if(!(condition)){ \
+            Test::failures++; \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " << #condition << std::endl; \
+        } \
+    } while(0)
+
+#endif
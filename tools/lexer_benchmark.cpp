@@ -0,0 +1,289 @@
+#include <lex.h>
+
+#include <chrono>
+#include <regex>
+
+/*
+    Benchmark of the grammar scanner against the regex lexer it replaced. Each grammar is lexed by both, the token streams are checked
+    to be identical, and the best time out of `repeat` runs is reported for each. Besides the given files, a synthetic grammar with
+    `rules` rules is written to a temporary file and lexed the same way
+
+    usage: lexer_benchmark [--rules n] [--repeat n] <grammar.qf>...
+*/
+
+namespace Reference {
+
+    /// @brief One entry of the regex lexer's token table, anchored at both ends unless it is only used in the full pattern
+    struct Rule {
+        Rule(const std::string& p, const Token::Kind& k, std::optional<std::string> v = std::nullopt, bool match_exact = true):
+            pattern(match_exact ? "^" + p + "$" : p),
+            kind(k),
+            value(v)
+        {}
+
+        Rule(const std::string& p, const Token::Kind& k, bool match_exact):
+            Rule(p, k, std::nullopt, match_exact)
+        {}
+
+        std::string pattern;
+        Token::Kind kind;
+        std::optional<std::string> value;
+    };
+
+    const std::vector<Rule> TOKEN_RULES = [] {
+        std::vector<Rule> rules;
+
+        for(const Lexer::Keyword& keyword : Lexer::KEYWORDS){
+            if((keyword.kind == Token::EXTERNAL) || (keyword.kind == Token::INTERNAL) || (keyword.kind == Token::OWNED)) continue;
+
+            if(keyword.kind == Token::SYNTAX){
+                rules.push_back(Rule(std::string(keyword.name), keyword.kind, std::string(keyword.value)));
+            } else {
+                rules.push_back(Rule(std::string(keyword.name), keyword.kind));
+            }
+        }
+
+        rules.push_back(Rule(R"(\".*?\"|\'.*?\')", Token::SYNTAX, false));
+
+        rules.push_back(Rule(R"(EXTERNAL(::)?)", Token::EXTERNAL, false));
+        rules.push_back(Rule(R"(INTERNAL(::)?)", Token::INTERNAL, false));
+        rules.push_back(Rule(R"(OWNED(::)?)", Token::OWNED, false));
+
+        rules.push_back(Rule(R"([a-zA-Z_]+)", Token::RULE, false));
+
+        rules.push_back(Rule(R"(\(\*)", Token::MULTI_COMMENT_START, false));
+        rules.push_back(Rule(R"(\*\))", Token::MULTI_COMMENT_END, false));
+        rules.push_back(Rule(R"(=|:)", Token::RULE_START, false));
+        rules.push_back(Rule(R"(\+=)", Token::RULE_APPEND, false));
+        rules.push_back(Rule(R"(\|)", Token::SEPARATOR, false));
+        rules.push_back(Rule(R"(;)", Token::RULE_END, false));
+        rules.push_back(Rule(R"(\()", Token::LPAREN, false));
+        rules.push_back(Rule(R"(\))", Token::RPAREN, false));
+        rules.push_back(Rule(R"(\[)", Token::LBRACK, false));
+        rules.push_back(Rule(R"(\])", Token::RBRACK, false));
+        rules.push_back(Rule(R"(\{)", Token::LBRACE, false));
+        rules.push_back(Rule(R"(\})", Token::RBRACE, false));
+        rules.push_back(Rule(R"(\*)", Token::ZERO_OR_MORE, false));
+        rules.push_back(Rule(R"(\?)", Token::OPTIONAL, false));
+        rules.push_back(Rule(R"(\+)", Token::ONE_OR_MORE, false));
+        rules.push_back(Rule(R"(\-\>)", Token::ARROW, false));
+        rules.push_back(Rule(R"(#)", Token::COMMENT, false));
+
+        return rules;
+    }();
+
+    const std::string FULL_REGEX = [] {
+        std::string regex = "(";
+
+        for (size_t i = 0; i < TOKEN_RULES.size(); i++) {
+            regex += TOKEN_RULES[i].pattern;
+
+            if (i + 1 < TOKEN_RULES.size()) regex += "|";
+        }
+        regex += ")";
+
+        return regex;
+    }();
+
+    /// @brief The lexer as it was before the scanner: one regex over each line, then every match tried against each rule in turn
+    class Lexer {
+        public:
+            Lexer(const std::string& filename){
+                lex(filename);
+            }
+
+            const std::vector<Token::Token>& get_tokens() const {return tokens;}
+
+        private:
+            std::string remove_outer_quotes(const std::string& token){
+                if ((token.size() > 2) &&
+                    (((token.front() == '\"') && (token.back() == '\"')) ||
+                    ((token.front() == '\'') && (token.back() == '\'')))
+                ){
+                    return token.substr(1, token.size() - 2);
+                }
+
+                return token;
+            }
+
+            inline bool string_is(const std::string& string, const std::string& pattern){
+                bool matches = std::regex_match(string, std::regex(pattern));
+                return ((ignore == false) && matches) || (string == "*)") ;
+            }
+
+            void lex(const std::string& filename){
+                std::string input, matched_string;
+                std::ifstream stream(filename);
+
+                std::regex full_pattern(FULL_REGEX, std::regex::icase);
+
+                std::sregex_iterator end;
+
+                while(std::getline(stream, input)){
+
+                    std::sregex_iterator begin(input.begin(), input.end(), full_pattern);
+
+                    for(std::sregex_iterator i = begin; (i != end); ++i){
+                        std::smatch match = *i;
+                        matched_string = match.str();
+
+                        if(string_is(matched_string, R"(#)")){
+                            break;
+
+                        } else if(string_is(matched_string, R"(\(\*)")){
+                            ignore = true;
+                            break;
+
+                        } else if (string_is(matched_string, R"(\*\))")){
+                            ignore = false;
+                            break;
+
+                        } else {
+
+                            for(const Rule& tr : TOKEN_RULES){
+                                if(string_is(matched_string, tr.pattern)){
+
+                                    if(tr.kind == Token::SYNTAX){
+                                        tokens.push_back(Token::Token{remove_outer_quotes(tr.value.value_or(matched_string)), tr.kind});
+
+                                    } else {
+                                        tokens.push_back(Token::Token{tr.value.value_or(matched_string), tr.kind});
+                                    }
+
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                }
+
+                tokens.push_back(Token::Token{.value = "", .kind = Token::_EOF});
+            }
+
+            std::vector<Token::Token> tokens;
+            bool ignore = false;
+    };
+}
+
+/// @brief Letters only, since the regex lexer doesn't allow digits in rule names
+static std::string synthetic_rule_name(size_t i){
+    std::string name = "rule_";
+
+    do {
+        name += (char)('a' + (i % 26));
+        i /= 26;
+    } while(i);
+
+    return name;
+}
+
+/// @brief A grammar of `n_rules` rules, each with a few branches mixing references to other rules, syntax, keywords and repetitions
+static void write_synthetic_grammar(const fs::path& path, size_t n_rules){
+    std::ofstream stream(path);
+    std::mt19937 rng(0);
+
+    // line comments only, the regex lexer never gets out of a (* *) comment
+    stream << "# synthetic grammar for lexer_benchmark\n\n";
+
+    for(size_t i = 0; i < n_rules; i++){
+        auto other = [&]{ return synthetic_rule_name(random_int(rng, n_rules - 1)); };
+
+        stream << synthetic_rule_name(i) << " = " << other() << " \"(\" " << other() << "* \")\" NEWLINE"
+            << " | qubit_list COMMA " << other() << "?"
+            << " | (" << other() << " | h | cx)+ ;"
+            << " # rule " << i << "\n";
+    }
+}
+
+/// @brief Best time in ms out of `repeat` runs of `lex`
+template<typename F>
+static double best_time(size_t repeat, F&& lex){
+    double best = std::numeric_limits<double>::max();
+
+    for(size_t r = 0; r < repeat; r++){
+        auto start = std::chrono::steady_clock::now();
+        lex();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        best = std::min(best, elapsed.count());
+    }
+
+    return best;
+}
+
+/// @brief Lex `path` with both lexers and print a line of results. False if the token streams differ
+static bool bench(const fs::path& path, size_t repeat){
+    std::vector<Token::Token> scanned = Lexer::Lexer(path.string()).get_tokens();
+    std::vector<Token::Token> matched = Reference::Lexer(path.string()).get_tokens();
+
+    double scanner_ms = best_time(repeat, [&]{ Lexer::Lexer lexer(path.string()); });
+    double regex_ms = best_time(repeat, [&]{ Reference::Lexer lexer(path.string()); });
+
+    bool same = (scanned == matched);
+
+    std::cout << std::left << std::setw(28) << path.filename().string() << std::right
+        << std::setw(10) << scanned.size() << " tokens"
+        << std::fixed << std::setprecision(3)
+        << std::setw(14) << regex_ms << " ms regex"
+        << std::setw(12) << scanner_ms << " ms scanner"
+        << std::setw(10) << std::setprecision(0) << (regex_ms / scanner_ms) << "x"
+        << (same ? "" : "  TOKEN STREAMS DIFFER") << std::endl;
+
+    if(!same){
+        auto [s, m] = std::mismatch(scanned.begin(), scanned.end(), matched.begin(), matched.end());
+        size_t at = s - scanned.begin();
+
+        std::cout << "    first difference at token " << at << ": scanner ";
+        if(s != scanned.end()) std::cout << *s; else std::cout << "<end>";
+        std::cout << ", regex ";
+        if(m != matched.end()) std::cout << *m; else std::cout << "<end>";
+        std::cout << std::endl;
+    }
+
+    return same;
+}
+
+int main(int argc, char** argv){
+
+    size_t n_rules = 10000, repeat = 5;
+    std::vector<fs::path> paths;
+
+    for(int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+
+        if(((arg == "--rules") || (arg == "--repeat")) && (i + 1 < argc)){
+            (arg == "--rules" ? n_rules : repeat) = std::stoul(argv[++i]);
+        } else if(arg.starts_with("--")){
+            std::cerr << "usage: " << argv[0] << " [--rules n] [--repeat n] <grammar.qf>..." << std::endl;
+            return 1;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    if(repeat == 0) repeat = 1;
+
+    bool all_same = true;
+
+    try {
+        for(const fs::path& path : paths){
+            all_same &= bench(path, repeat);
+        }
+
+        if(n_rules){
+            fs::path synthetic = fs::temp_directory_path() / ("synthetic_" + std::to_string(n_rules) + ".qf");
+            write_synthetic_grammar(synthetic, n_rules);
+
+            // the regex lexer takes tens of seconds on the synthetic grammar, once is enough
+            all_same &= bench(synthetic, 1);
+
+            fs::remove(synthetic);
+        }
+
+    } catch (const std::exception& error) {
+        ERROR(error.what());
+        return 1;
+    }
+
+    return all_same ? 0 : 1;
+}